@@ -1,12 +1,20 @@
 //------------------------json.hpp--------------------------------------------
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
 #include <istream>
 #include <map>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <optional>
+#include <stdexcept>
 
 namespace Json {
 class Node;
@@ -14,113 +22,559 @@ class Node;
 using Map = std::map<std::string, Node>;
 using Array = std::vector<Node>;
 
-class Node : std::variant<Array,
-        Map,
-        int32_t,
-        double,
-        bool,
-        std::string> {
+/**
+ * @brief Contents of json string literal without quotes: copied as is when
+ * there are no escapes, otherwise escapes including \uXXXX surrogate pairs
+ * are decoded to UTF-8. Throws ParseError for malformed escapes
+ */
+std::string DecodeString(std::string_view raw);
+
+/**
+ * @brief Appends text escaped as contents of json string literal,
+ * non-ASCII UTF-8 is kept as is
+ */
+void EscapeString(std::string_view text, std::string & output);
+
+struct PrintOptions {
+  /// significant digits of doubles, 0 prints the shortest text that reads back exactly,
+  /// more than 17 are printed as 17, which already read back any double
+  int precision = 7;
+};
+
+/**
+ * @brief Tag and a union of scalar or pointer, 16 bytes on 64-bit platforms.
+ * Containers and strings live out of line and are owned by the node,
+ * copies are deep as they were with std::variant
+ */
+class Node {
 public:
-  using variant::variant;
+  Node() noexcept : m_tag(Tag::ARRAY) {
+    m_value.array = nullptr;
+  }
+  Node(Array value) : m_tag(Tag::ARRAY) {
+    m_value.array = value.empty() ? nullptr : new Array(std::move(value));
+  }
+  Node(Map value) : m_tag(Tag::MAP) {
+    m_value.map = new Map(std::move(value));
+  }
+  Node(int32_t value) noexcept : m_tag(Tag::INT) {
+    m_value.as_int = value;
+  }
+  Node(double value) noexcept : m_tag(Tag::DOUBLE) {
+    m_value.as_double = value;
+  }
+  Node(bool value) noexcept : m_tag(Tag::BOOL) {
+    m_value.as_bool = value;
+  }
+  Node(std::string value) : m_tag(Tag::STRING) {
+    m_value.string = new std::string(std::move(value));
+  }
+  Node(char const * value) : Node(std::string(value)) {}
+
+  Node(Node const & other) : m_tag(other.m_tag) {
+    switch (m_tag) {
+      case Tag::ARRAY:
+        m_value.array = other.m_value.array ? new Array(*other.m_value.array) : nullptr;
+        break;
+      case Tag::MAP:
+        m_value.map = new Map(*other.m_value.map);
+        break;
+      case Tag::STRING:
+        m_value.string = new std::string(*other.m_value.string);
+        break;
+      default:
+        m_value = other.m_value;
+    }
+  }
+  Node(Node && other) noexcept : m_value(other.m_value), m_tag(other.m_tag) {
+    other.m_tag = Tag::ARRAY;
+    other.m_value.array = nullptr;
+  }
+  Node & operator=(Node other) noexcept {
+    std::swap(m_value, other.m_value);
+    std::swap(m_tag, other.m_tag);
+    return *this;
+  }
+  ~Node() {
+    switch (m_tag) {
+      case Tag::ARRAY:
+        delete m_value.array;
+        break;
+      case Tag::MAP:
+        delete m_value.map;
+        break;
+      case Tag::STRING:
+        delete m_value.string;
+        break;
+      default:
+        break;
+    }
+  }
 
   void AddValue(Json::Node value_node, std::string key = "") {
     if (IsType<Array>()) {
-      std::get<Array>(*this).push_back(value_node);
+      if (!m_value.array) {
+        m_value.array = new Array;
+      }
+      m_value.array->push_back(std::move(value_node));
     }
     else if (IsType<Map>()) {
-      std::get<Map>(*this)[key] = value_node;
+      (*m_value.map)[key] = std::move(value_node);
     }
   }
 
   template<class T>
   bool IsType() const {
-    return std::holds_alternative<T>(*this);
+    return m_tag == TagOf<T>();
   }
 
-  const auto& AsArray() const {
-    return std::get<std::vector<Node>>(*this);
+  const Array& AsArray() const {
+    static Array const empty;
+    Check(Tag::ARRAY);
+    return m_value.array ? *m_value.array : empty;
+  }
+  const Map& AsMap() const {
+    Check(Tag::MAP);
+    return *m_value.map;
+  }
+  /**
+   * @brief Mutable access lets callers move children out instead of copying them,
+   * allocates storage of empty array
+   */
+  Array& AsArray() {
+    Check(Tag::ARRAY);
+    if (!m_value.array) {
+      m_value.array = new Array;
+    }
+    return *m_value.array;
   }
-  const auto& AsMap() const {
-    return std::get<std::map<std::string, Node>>(*this);
+  Map& AsMap() {
+    Check(Tag::MAP);
+    return *m_value.map;
   }
-  const auto& AsInt() const {
+  const int32_t& AsInt() const {
     /*if (IsType<double>()) {
       return static_cast<int32_t>(AsDouble());
     }*/
-    return std::get<int32_t>(*this);
+    Check(Tag::INT);
+    return m_value.as_int;
   }
   double AsDouble() const {
     if (IsType<int32_t>()) {
       return static_cast<double>(AsInt());
     }
-    return std::get<double>(*this);
+    Check(Tag::DOUBLE);
+    return m_value.as_double;
   }
   bool AsBool() const {
-    return std::get<bool>(*this);
+    Check(Tag::BOOL);
+    return m_value.as_bool;
   }
-  const auto& AsString() const {
-    return std::get<std::string>(*this);
+  const std::string& AsString() const {
+    Check(Tag::STRING);
+    return *m_value.string;
   }
 
-  std::string ToString() const {
-    std::stringstream ss;
-    if (IsType<Array>()) {
-      ss << "[";
-      auto const & this_array = this->AsArray();
-      for (int32_t i = 0; i < this_array.size(); i++) {
-        ss << this_array[i].ToString();
-        if (i + 1 != this_array.size()) {
-          ss << ", ";
+  /**
+   * @brief Appends json text of node to output, so one buffer can be reused
+   */
+  void PrintTo(std::string & output, PrintOptions const & options = {}) const {
+    switch (m_tag) {
+      case Tag::ARRAY: {
+        output += '[';
+        auto const & this_array = AsArray();
+        for (size_t i = 0; i < this_array.size(); i++) {
+          if (i != 0) {
+            output += ", ";
+          }
+          this_array[i].PrintTo(output, options);
         }
+        output += ']';
+        break;
       }
-      ss << "]";
-    }
-    if (IsType<Map>()) {
-      ss << "{";
-      auto const & this_map = this->AsMap();
-      for (auto it = this_map.begin(); it != this_map.end(); it++) {
-        ss << "\"" << it->first << "\":";
-        ss << it->second.ToString();
-        if (std::next(it) != this_map.end()) {
-          ss << ", ";
+      case Tag::MAP: {
+        output += '{';
+        auto const & this_map = AsMap();
+        for (auto it = this_map.begin(); it != this_map.end(); it++) {
+          if (it != this_map.begin()) {
+            output += ", ";
+          }
+          output += '"';
+          EscapeString(it->first, output);
+          output += "\":";
+          it->second.PrintTo(output, options);
         }
+        output += '}';
+        break;
       }
-      ss << "}";
-    }
-    if (IsType<int32_t>()) {
-      ss << this->AsInt();
-    }
-    if (IsType<double>()) {
-      ss << std::setprecision(7);
-      ss << this->AsDouble();
+      case Tag::INT:
+        PrintNumber(output, m_value.as_int);
+        break;
+      case Tag::DOUBLE:
+        if (!std::isfinite(m_value.as_double)) {
+          // json has no infinities and nans, null is what JavaScript prints for them
+          output += "null";
+        } else if (options.precision > 0) {
+          PrintNumber(output, m_value.as_double, std::chars_format::general, std::min(options.precision, 17));
+        } else {
+          PrintNumber(output, m_value.as_double);
+        }
+        break;
+      case Tag::BOOL:
+        output += m_value.as_bool ? "true" : "false";
+        break;
+      case Tag::STRING:
+        output += '"';
+        EscapeString(*m_value.string, output);
+        output += '"';
+        break;
     }
-    if (IsType<bool>()) {
-      ss << std::boolalpha;
-      ss << this->AsBool();
+  }
+
+  std::string ToString(PrintOptions const & options = {}) const {
+    std::string output;
+    PrintTo(output, options);
+    return output;
+  }
+
+private:
+  enum class Tag : uint8_t {
+    ARRAY,
+    MAP,
+    INT,
+    DOUBLE,
+    BOOL,
+    STRING,
+  };
+
+  union Value {
+    int32_t as_int;
+    double as_double;
+    bool as_bool;
+    // nullptr for empty array, so default nodes do not allocate
+    Array * array;
+    Map * map;
+    std::string * string;
+  };
+
+  template<typename... Args>
+  static void PrintNumber(std::string & output, Args... args) {
+    // enough for any double in shortest form or with up to 17 digits and for int32_t
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), args...);
+    if (result.ec != std::errc()) {
+      throw std::length_error("number does not fit print buffer");
     }
-    if (IsType<std::string>()) {
-      ss << "\"" << this->AsString() << "\"";
+    output.append(buffer, result.ptr);
+  }
+
+  template<class T>
+  static constexpr Tag TagOf() {
+    if constexpr (std::is_same_v<T, Array>) {
+      return Tag::ARRAY;
+    } else if constexpr (std::is_same_v<T, Map>) {
+      return Tag::MAP;
+    } else if constexpr (std::is_same_v<T, int32_t>) {
+      return Tag::INT;
+    } else if constexpr (std::is_same_v<T, double>) {
+      return Tag::DOUBLE;
+    } else if constexpr (std::is_same_v<T, bool>) {
+      return Tag::BOOL;
+    } else {
+      static_assert(std::is_same_v<T, std::string>, "not a json node type");
+      return Tag::STRING;
     }
+  }
 
-    return ss.str();
+  void Check(Tag tag) const {
+    if (m_tag != tag) {
+      throw std::bad_variant_access();
+    }
   }
+
+  Value m_value;
+  Tag m_tag;
 };
 
+static_assert(sizeof(Node) <= 16, "Json::Node should stay compact");
+
 class Document {
 public:
   explicit Document(Node root);
 
   const Node& GetRoot() const;
+  Node& GetRoot();
 
 private:
   Node root;
 };
 
+class ParseError : public std::runtime_error {
+public:
+  using runtime_error::runtime_error;
+};
+
+/**
+ * @brief Loads whole input: finds structurals first, then builds nodes from them
+ */
 Document Load(std::istream& input);
+Document Load(std::string_view input);
+
+/**
+ * @brief Loads one value reading input char by char, reference for Load
+ */
+Document LoadFromStream(std::istream& input);
+
+/**
+ * @brief Stage two for one value starting at structural idx, moves idx past it
+ */
+Node LoadIndexed(std::string_view input, std::vector<uint32_t> const & positions, size_t & idx);
+
+/**
+ * @brief Parses json number token: integers fitting int32_t become int32_t
+ * nodes, other numbers become correctly rounded double nodes
+ */
+std::optional<Node> ParseNumber(std::string_view token);
+
+}
+
+//------------------------json_scanner.hpp------------------------------------
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace Json {
+/**
+ * @brief Stage one of loading: positions of structural characters
+ * '{', '}', '[', ']', ':', ',' outside of strings, of unescaped quotes
+ * and of first characters of scalars (numbers, true, false, null).
+ * Input is classified by 64-byte blocks.
+ */
+class StructuralScanner {
+public:
+  /**
+   * @brief Fills positions, uses AVX2 or SSE2 when compiled with them
+   */
+  static void FindStructurals(std::string_view input, std::vector<uint32_t> & positions);
+
+  /**
+   * @brief Same as FindStructurals, classifies characters one by one
+   */
+  static void FindStructuralsScalar(std::string_view input, std::vector<uint32_t> & positions);
+
+private:
+  struct BlockMasks {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t whitespace = 0;
+    uint64_t op = 0;
+  };
+
+  /**
+   * @brief State carried between blocks
+   */
+  struct Carry {
+    bool is_escaped = false;
+    bool is_in_string = false;
+    bool is_in_scalar = false;
+  };
+
+  template <typename ClassifyFunc>
+  static void Scan(std::string_view input, std::vector<uint32_t> & positions, ClassifyFunc classify);
+
+  static uint64_t Structurals(BlockMasks const & masks, Carry & carry);
+
+  static BlockMasks ClassifyScalar(char const * block);
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+  static BlockMasks ClassifySimd(char const * block);
+#endif
+};
+
+inline void StructuralScanner::FindStructurals(std::string_view input, std::vector<uint32_t> & positions) {
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+  Scan(input, positions, ClassifySimd);
+#else
+  Scan(input, positions, ClassifyScalar);
+#endif
+}
+
+inline void StructuralScanner::FindStructuralsScalar(std::string_view input, std::vector<uint32_t> & positions) {
+  Scan(input, positions, ClassifyScalar);
+}
+
+template <typename ClassifyFunc>
+void StructuralScanner::Scan(std::string_view input, std::vector<uint32_t> & positions, ClassifyFunc classify) {
+  positions.clear();
+  // structurals are rarely denser than one per 4 bytes
+  positions.reserve(input.size() / 4 + 1);
+
+  Carry carry;
+  char tail[64];
+  for (size_t offset = 0; offset < input.size(); offset += 64) {
+    char const * block = input.data() + offset;
+    if (input.size() - offset < 64) {
+      // last block is padded with spaces
+      std::fill(std::copy(block, input.data() + input.size(), tail), tail + 64, ' ');
+      block = tail;
+    }
+
+    uint64_t structurals = Structurals(classify(block), carry);
+    while (structurals) {
+#if defined(__GNUC__)
+      int bit = __builtin_ctzll(structurals);
+#else
+      int bit = 0;
+      while (!(structurals >> bit & 1u)) {
+        ++bit;
+      }
+#endif
+      positions.push_back(static_cast<uint32_t>(offset + bit));
+      structurals &= structurals - 1;
+    }
+  }
+}
+
+inline uint64_t StructuralScanner::Structurals(BlockMasks const & masks, Carry & carry) {
+  // backslashes are rare, so escaped characters are found by walking them
+  uint64_t escaped = carry.is_escaped ? 1u : 0u;
+  carry.is_escaped = false;
+  for (uint64_t backslash = masks.backslash; backslash; backslash &= backslash - 1) {
+#if defined(__GNUC__)
+    int bit = __builtin_ctzll(backslash);
+#else
+    int bit = 0;
+    while (!(backslash >> bit & 1u)) {
+      ++bit;
+    }
+#endif
+    if (escaped >> bit & 1u) {
+      continue;
+    }
+    if (bit == 63) {
+      carry.is_escaped = true;
+    } else {
+      escaped |= uint64_t(1) << (bit + 1);
+    }
+  }
 
+  uint64_t quote = masks.quote & ~escaped;
+
+  // prefix xor: bit is set for opening quote and characters inside string
+  uint64_t in_string = quote;
+  in_string ^= in_string << 1;
+  in_string ^= in_string << 2;
+  in_string ^= in_string << 4;
+  in_string ^= in_string << 8;
+  in_string ^= in_string << 16;
+  in_string ^= in_string << 32;
+  if (carry.is_in_string) {
+    in_string = ~in_string;
+  }
+  carry.is_in_string = in_string >> 63;
+
+  uint64_t scalar = ~(masks.op | masks.whitespace | quote | in_string);
+  uint64_t scalar_start = scalar & ~(scalar << 1 | (carry.is_in_scalar ? 1u : 0u));
+  carry.is_in_scalar = scalar >> 63;
+
+  return (masks.op & ~in_string) | quote | scalar_start;
+}
+
+inline StructuralScanner::BlockMasks StructuralScanner::ClassifyScalar(char const * block) {
+  BlockMasks masks;
+  for (int i = 0; i < 64; i++) {
+    uint64_t bit = uint64_t(1) << i;
+    switch (block[i]) {
+      case '"':
+        masks.quote |= bit;
+        break;
+      case '\\':
+        masks.backslash |= bit;
+        break;
+      case ' ':
+      case '\t':
+      case '\n':
+      case '\r':
+        masks.whitespace |= bit;
+        break;
+      case '{':
+      case '}':
+      case '[':
+      case ']':
+      case ':':
+      case ',':
+        masks.op |= bit;
+        break;
+      default:
+        break;
+    }
+  }
+  return masks;
+}
+
+#if defined(__AVX2__)
+inline StructuralScanner::BlockMasks StructuralScanner::ClassifySimd(char const * block) {
+  BlockMasks masks;
+  for (int half = 0; half < 2; half++) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(block + half * 32));
+    auto eq = [&chunk](char c) {
+      return _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(c));
+    };
+    auto to_mask = [half](__m256i v) {
+      return static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(v))) << (half * 32);
+    };
+
+    masks.quote |= to_mask(eq('"'));
+    masks.backslash |= to_mask(eq('\\'));
+    masks.whitespace |= to_mask(_mm256_or_si256(_mm256_or_si256(eq(' '), eq('\t')),
+                                                _mm256_or_si256(eq('\n'), eq('\r'))));
+    // '[' 0x5B and '{' 0x7B, ']' 0x5D and '}' 0x7D differ only in bit 0x20
+    __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+    __m256i brackets = _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8(0x7B)),
+                                       _mm256_cmpeq_epi8(folded, _mm256_set1_epi8(0x7D)));
+    masks.op |= to_mask(_mm256_or_si256(brackets, _mm256_or_si256(eq(':'), eq(','))));
+  }
+  return masks;
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+inline StructuralScanner::BlockMasks StructuralScanner::ClassifySimd(char const * block) {
+  BlockMasks masks;
+  for (int quarter = 0; quarter < 4; quarter++) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(block + quarter * 16));
+    auto eq = [&chunk](char c) {
+      return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(c));
+    };
+    auto to_mask = [quarter](__m128i v) {
+      return static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(v))) << (quarter * 16);
+    };
+
+    masks.quote |= to_mask(eq('"'));
+    masks.backslash |= to_mask(eq('\\'));
+    masks.whitespace |= to_mask(_mm_or_si128(_mm_or_si128(eq(' '), eq('\t')),
+                                             _mm_or_si128(eq('\n'), eq('\r'))));
+    // '[' 0x5B and '{' 0x7B, ']' 0x5D and '}' 0x7D differ only in bit 0x20
+    __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    __m128i brackets = _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8(0x7B)),
+                                    _mm_cmpeq_epi8(folded, _mm_set1_epi8(0x7D)));
+    masks.op |= to_mask(_mm_or_si128(brackets, _mm_or_si128(eq(':'), eq(','))));
+  }
+  return masks;
 }
+#endif
+} // namespace Json
 
 //------------------------json.cpp--------------------------------------------
+#include <charconv>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
 
 namespace Json {
 
@@ -131,6 +585,172 @@ const Node& Document::GetRoot() const {
   return root;
 }
 
+Node& Document::GetRoot() {
+  return root;
+}
+
+namespace {
+/**
+ * @brief Ascii digit test that is defined for negative chars of
+ * non-ascii bytes and for EOF of peek, unlike isdigit
+ */
+bool IsDigit(int c) {
+  return '0' <= c && c <= '9';
+}
+
+uint32_t ReadHex4(std::string_view raw, size_t pos) {
+  uint32_t code = 0;
+  auto [ptr, ec] = std::from_chars(raw.data() + std::min(pos, raw.size()),
+                                   raw.data() + std::min(pos + 4, raw.size()), code, 16);
+  if (ec != std::errc() || ptr != raw.data() + pos + 4) {
+    throw ParseError("bad \\u escape in \"" + std::string(raw) + "\"");
+  }
+  return code;
+}
+
+void AppendUtf8(uint32_t code, std::string & output) {
+  if (code < 0x80) {
+    output += static_cast<char>(code);
+  } else if (code < 0x800) {
+    output += static_cast<char>(0xC0 | (code >> 6));
+    output += static_cast<char>(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    output += static_cast<char>(0xE0 | (code >> 12));
+    output += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    output += static_cast<char>(0x80 | (code & 0x3F));
+  } else {
+    output += static_cast<char>(0xF0 | (code >> 18));
+    output += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+    output += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    output += static_cast<char>(0x80 | (code & 0x3F));
+  }
+}
+
+/**
+ * @brief Position of first char from pos that should be escaped:
+ * quote, backslash or control character
+ */
+size_t FindEscaped(std::string_view text, size_t pos) {
+#if defined(__SSE2__) || defined(_M_X64)
+  __m128i const quote = _mm_set1_epi8('"');
+  __m128i const backslash = _mm_set1_epi8('\\');
+  __m128i const control_max = _mm_set1_epi8(0x1F);
+  for (; pos + 16 <= text.size(); pos += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(text.data() + pos));
+    __m128i is_escaped = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control_max), control_max));
+    if (int mask = _mm_movemask_epi8(is_escaped)) {
+      return pos + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+  }
+#endif
+  for (; pos < text.size(); pos++) {
+    unsigned char c = text[pos];
+    if (c == '"' || c == '\\' || c < 0x20) {
+      return pos;
+    }
+  }
+  return text.size();
+}
+} // namespace
+
+std::string DecodeString(std::string_view raw) {
+  size_t pos = raw.find('\\');
+  if (pos == std::string_view::npos) {
+    return std::string(raw);
+  }
+
+  std::string result;
+  result.reserve(raw.size());
+  size_t done = 0;
+  for (; pos != std::string_view::npos; pos = raw.find('\\', done)) {
+    result.append(raw.substr(done, pos - done));
+    if (pos + 1 == raw.size()) {
+      throw ParseError("unfinished escape in \"" + std::string(raw) + "\"");
+    }
+    done = pos + 2;
+    switch (char c = raw[pos + 1]) {
+      case '"': case '\\': case '/':
+        result += c;
+        break;
+      case 'b':
+        result += '\b';
+        break;
+      case 'f':
+        result += '\f';
+        break;
+      case 'n':
+        result += '\n';
+        break;
+      case 'r':
+        result += '\r';
+        break;
+      case 't':
+        result += '\t';
+        break;
+      case 'u': {
+        uint32_t code = ReadHex4(raw, done);
+        done += 4;
+        if (code >= 0xD800 && code <= 0xDBFF) {
+          // characters outside of BMP are written as surrogate pair
+          uint32_t low = raw.substr(done, 2) == "\\u" ? ReadHex4(raw, done + 2) : 0;
+          if (low < 0xDC00 || low > 0xDFFF) {
+            throw ParseError("unpaired surrogate in \"" + std::string(raw) + "\"");
+          }
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          done += 6;
+        } else if (code >= 0xDC00 && code <= 0xDFFF) {
+          throw ParseError("unpaired surrogate in \"" + std::string(raw) + "\"");
+        }
+        AppendUtf8(code, result);
+        break;
+      }
+      default:
+        throw ParseError(std::string("bad escape \\") + c + " in \"" + std::string(raw) + "\"");
+    }
+  }
+  result.append(raw.substr(done));
+  return result;
+}
+
+void EscapeString(std::string_view text, std::string & output) {
+  static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+  size_t done = 0;
+  for (size_t pos = FindEscaped(text, 0); pos != text.size(); pos = FindEscaped(text, done)) {
+    output.append(text.substr(done, pos - done));
+    switch (unsigned char c = text[pos]) {
+      case '"':
+        output += "\\\"";
+        break;
+      case '\\':
+        output += "\\\\";
+        break;
+      case '\b':
+        output += "\\b";
+        break;
+      case '\f':
+        output += "\\f";
+        break;
+      case '\n':
+        output += "\\n";
+        break;
+      case '\r':
+        output += "\\r";
+        break;
+      case '\t':
+        output += "\\t";
+        break;
+      default:
+        output += "\\u00";
+        output += HEX_DIGITS[c >> 4];
+        output += HEX_DIGITS[c & 0xF];
+    }
+    done = pos + 1;
+  }
+  output.append(text.substr(done));
+}
+
 Node LoadNode(std::istream& input);
 
 Node LoadArray(std::istream& input) {
@@ -154,7 +774,7 @@ Node LoadNumber(std::istream& input) {
   }
 
   int32_t result = 0;
-  while (isdigit(input.peek())) {
+  while (IsDigit(input.peek())) {
     result *= 10;
     result += input.get() - '0';
   }
@@ -163,7 +783,7 @@ Node LoadNumber(std::istream& input) {
     input.ignore(1); // pass '.'
     double d_result = result;
     double multiplier = 0.1;
-    while (isdigit(input.peek())) {
+    while (IsDigit(input.peek())) {
       d_result += (input.get() - '0') * multiplier;
       multiplier /= 10.0;
     }
@@ -191,8 +811,13 @@ Node LoadBoolean(std::istream& input) {
 
 Node LoadString(std::istream& input) {
   std::string line;
-  getline(input, line, '"');
-  return Node(std::move(line));
+  for (char c; input.get(c) && c != '"'; ) {
+    line += c;
+    if (c == '\\' && input.get(c)) {
+      line += c;
+    }
+  }
+  return Node(DecodeString(line));
 }
 
 Node LoadDict(std::istream& input) {
@@ -230,525 +855,5086 @@ Node LoadNode(std::istream& input) {
   }
 }
 
-Document Load(std::istream& input) {
+Document LoadFromStream(std::istream& input) {
   return Document{LoadNode(input)};
 }
 
-}
-
-//------------------------geom2d.hpp------------------------------------------
-#include <vector>
-#include <cmath>
-#include <cstdint>
-
-namespace geom2d {
-class PointD {
-public:
-  explicit PointD(double _lat, double _lon)
-          : lat(_lat), lon(_lon) {}
-  PointD() = default;
+std::optional<Node> ParseNumber(std::string_view token) {
+  char const * const begin = token.data();
+  char const * const end = token.data() + token.size();
+
+  // json grammar: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+  char const * it = begin;
+  bool const is_negative = it != end && *it == '-';
+  it += is_negative;
+  char const * const int_begin = it;
+  uint64_t mantissa = 0;
+  int32_t digit_count = 0;
+  int32_t exponent = 0;
+  for (; it != end && IsDigit(*it); ++it) {
+    if (digit_count < 19) {
+      mantissa = mantissa * 10 + (*it - '0');
+    } else {
+      ++exponent;
+    }
+    digit_count += mantissa != 0;
+  }
+  if (it == int_begin || (*int_begin == '0' && it - int_begin > 1)) {
+    return std::nullopt;
+  }
 
-  double GetLat() const {
-    return lat;
+  bool is_integer = true;
+  if (it != end && *it == '.') {
+    is_integer = false;
+    char const * const frac_begin = ++it;
+    for (; it != end && IsDigit(*it); ++it) {
+      if (digit_count < 19) {
+        mantissa = mantissa * 10 + (*it - '0');
+        --exponent;
+      }
+      digit_count += mantissa != 0;
+    }
+    if (it == frac_begin) {
+      return std::nullopt;
+    }
   }
-  double GetLon() const {
-    return lon;
+  if (it != end && (*it == 'e' || *it == 'E')) {
+    is_integer = false;
+    ++it;
+    bool const is_exp_negative = it != end && *it == '-';
+    it += it != end && (*it == '-' || *it == '+');
+    char const * const exp_begin = it;
+    int32_t exp_value = 0;
+    for (; it != end && IsDigit(*it); ++it) {
+      exp_value = std::min(exp_value * 10 + (*it - '0'), 100000);
+    }
+    if (it == exp_begin) {
+      return std::nullopt;
+    }
+    exponent += is_exp_negative ? -exp_value : exp_value;
+  }
+  if (it != end) {
+    return std::nullopt;
   }
-private:
-  double lat;
-  double lon;
-};
 
-constexpr int32_t EARTH_RADIUS_KM = 6371;
-constexpr double PI = 3.1415926535;
+  if (is_integer && digit_count <= 18) {
+    int64_t value = is_negative ? -static_cast<int64_t>(mantissa) : static_cast<int64_t>(mantissa);
+    if (value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max()) {
+      return Node(static_cast<int32_t>(value));
+    }
+    // out of int32_t range, exact as double up to 2^53
+    return Node(static_cast<double>(value));
+  }
 
-static double ToRadians(long double degree) {
-  double one_deg = PI / 180.0;
-  return one_deg * degree;
+  // Clinger's fast path: both mantissa and power of ten are exact doubles,
+  // so one multiplication or division is correctly rounded
+  static constexpr double POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+  if (digit_count <= 19 && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+    double value = static_cast<double>(mantissa);
+    value = exponent < 0 ? value / POWERS_OF_TEN[-exponent] : value * POWERS_OF_TEN[exponent];
+    return Node(is_negative ? -value : value);
+  }
+
+  // libstdc++ from_chars is Eisel-Lemire with exact fallback
+  double value = 0;
+  auto [ptr, ec] = std::from_chars(begin, end, value);
+  if (ptr != end) {
+    return std::nullopt;
+  }
+  if (ec == std::errc::result_out_of_range) {
+    value = exponent > 0 ? std::numeric_limits<double>::infinity() : 0.0;
+    value = is_negative ? -value : value;
+  }
+  return Node(value);
 }
 
+namespace {
 /**
- * @brief Calculates distance on earth between 2 PointD
+ * @brief Stage two of loading: builds nodes walking structural positions
  */
-static double CalculateDistance(PointD const & pt1, PointD const & pt2) {
-  double lat1 = ToRadians(pt1.GetLat());
-  double lon1 = ToRadians(pt1.GetLon());
-  double lat2 = ToRadians(pt2.GetLat());
-  double lon2 = ToRadians(pt2.GetLon());
+class IndexedLoader {
+public:
+  IndexedLoader(std::string_view input, std::vector<uint32_t> const & positions, size_t idx = 0)
+          : m_input(input), m_positions(positions), m_idx(idx) {}
 
-  double dlon = lon2 - lon1;
-  double dlat = lat2 - lat1;
+  Node LoadRoot() {
+    Node root = LoadNode();
+    if (m_idx != m_positions.size()) {
+      throw ParseError("unexpected data after root value");
+    }
+    return root;
+  }
 
-  long double ans = std::pow(std::sin(dlat / 2), 2) +
-                    std::cos(lat1) * std::cos(lat2) *
-                    std::pow(std::sin(dlon / 2), 2);
+  Node LoadValue() {
+    return LoadNode();
+  }
 
-  ans = 2 * asin(sqrt(ans));
+  size_t GetIdx() const {
+    return m_idx;
+  }
 
-  // Calculate the result
-  ans *= EARTH_RADIUS_KM;
+private:
+  char Peek() const {
+    if (m_idx >= m_positions.size()) {
+      throw ParseError("unexpected end of input");
+    }
+    return m_input[m_positions[m_idx]];
+  }
 
-  //convert to meters
-  ans *= 1000.0;
+  void Expect(char c) {
+    if (Peek() != c) {
+      throw ParseError(std::string("expected '") + c + "' at " + std::to_string(m_positions[m_idx]));
+    }
+    ++m_idx;
+  }
 
-  return ans;
+  Node LoadNode() {
+    switch (Peek()) {
+      case '[':
+        return LoadArray();
+      case '{':
+        return LoadDict();
+      case '"':
+        return Node(LoadString());
+      default:
+        return LoadScalar();
+    }
+  }
+
+  Node LoadArray() {
+    Expect('[');
+    Array result;
+    if (Peek() == ']') {
+      ++m_idx;
+      return Node(std::move(result));
+    }
+    while (true) {
+      result.push_back(LoadNode());
+      if (Peek() == ']') {
+        ++m_idx;
+        return Node(std::move(result));
+      }
+      Expect(',');
+    }
+  }
+
+  Node LoadDict() {
+    Expect('{');
+    Map result;
+    if (Peek() == '}') {
+      ++m_idx;
+      return Node(std::move(result));
+    }
+    while (true) {
+      std::string key = LoadString();
+      Expect(':');
+      result.emplace(std::move(key), LoadNode());
+      if (Peek() == '}') {
+        ++m_idx;
+        return Node(std::move(result));
+      }
+      Expect(',');
+    }
+  }
+
+  std::string LoadString() {
+    Expect('"');
+    // everything up to closing quote is inside string, so it is the next structural
+    size_t begin = m_positions[m_idx - 1] + 1;
+    Expect('"');
+    size_t end = m_positions[m_idx - 1];
+    return DecodeString(m_input.substr(begin, end - begin));
+  }
+
+  Node LoadScalar() {
+    size_t begin = m_positions[m_idx++];
+    size_t end = begin;
+    while (end < m_input.size() && !IsDelimiter(m_input[end])) {
+      ++end;
+    }
+    std::string_view token = m_input.substr(begin, end - begin);
+
+    if (token == "true") {
+      return Node(true);
+    } else if (token == "false") {
+      return Node(false);
+    }
+    return LoadNumber(token);
+  }
+
+  static Node LoadNumber(std::string_view token) {
+    if (std::optional<Node> node = ParseNumber(token)) {
+      return std::move(*node);
+    }
+    throw ParseError("bad number " + std::string(token));
+  }
+
+  static bool IsDelimiter(char c) {
+    switch (c) {
+      case ' ': case '\t': case '\n': case '\r':
+      case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  std::string_view m_input;
+  std::vector<uint32_t> const & m_positions;
+  size_t m_idx;
+};
+} // namespace
+
+Node LoadIndexed(std::string_view input, std::vector<uint32_t> const & positions, size_t & idx) {
+  IndexedLoader loader(input, positions, idx);
+  Node result = loader.LoadValue();
+  idx = loader.GetIdx();
+  return result;
 }
 
-/**
- * @brief Calculate ratio between road distance and earth distance
- * @param dist_road road distance
- * @param dist_earth earth distance
- * @return curvature
- */
-static double CalculateCurvature(int32_t dist_road, long double dist_earth) {
-  return static_cast<double>(dist_road) / dist_earth;
+Document Load(std::string_view input) {
+  if (input.size() > UINT32_MAX) {
+    throw ParseError("input is larger than 4 GiB");
+  }
+  std::vector<uint32_t> positions;
+  StructuralScanner::FindStructurals(input, positions);
+  return Document{IndexedLoader(input, positions).LoadRoot()};
 }
-} // namespace geom2d
 
-//------------------------bus_model.hpp---------------------------------------
+Document Load(std::istream& input) {
+  std::string buffer{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+  return Load(std::string_view(buffer));
+}
+
+}
+
+//------------------------json_lazy.hpp---------------------------------------
+#include <iterator>
 #include <string>
-#include <memory>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
+#include <vector>
 
-namespace bus_model {
-class Bus;
-class Stop;
-using BusPtr = std::shared_ptr<Bus>;
-using StopPtr = std::shared_ptr<Stop>;
+namespace Json {
+class LazyDocument;
+class LazyArray;
+class LazyMap;
 
-class Bus {
+/**
+ * @brief Value inside LazyDocument, decoded only when accessed
+ */
+class LazyNode {
 public:
-  Bus(std::string _name);
+  LazyNode(LazyDocument const & document, uint32_t idx);
+
+  bool IsArray() const;
+  bool IsMap() const;
+  bool IsString() const;
+
+  LazyArray AsArray() const;
+  LazyMap AsMap() const;
+  int32_t AsInt() const;
+  double AsDouble() const;
+  bool AsBool() const;
+  std::string AsString() const;
+
+  /**
+   * @brief Builds ordinary node of this value with whole its subtree
+   */
+  Node Materialize() const;
 
-  std::string_view GetName() const;
-  std::vector<std::string> const & GetRoute() const;
-  void SetRoute(std::vector<std::string> route);
 private:
-  std::string m_name;
-  std::vector<std::string> m_route;
+  char Front() const;
+
+  LazyDocument const * m_document;
+  uint32_t m_idx;
 };
 
-class Stop {
+/**
+ * @brief Elements are found by jumping over sibling subtrees,
+ * so access to i-th element costs i skips
+ */
+class LazyArray {
 public:
-  Stop(std::string _name);
+  class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = LazyNode;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = LazyNode;
+
+    Iterator(LazyDocument const & document, uint32_t idx);
+
+    LazyNode operator*() const;
+    Iterator & operator++();
+    bool operator==(Iterator const & other) const;
+    bool operator!=(Iterator const & other) const;
+
+  private:
+    LazyDocument const * m_document;
+    uint32_t m_idx;
+  };
 
-  std::string_view GetName() const;
-  void SetPoint(geom2d::PointD point);
-  geom2d::PointD const & GetPoint() const;
+  LazyArray(LazyDocument const & document, uint32_t idx);
+
+  Iterator begin() const;
+  Iterator end() const;
+  size_t size() const;
+  bool empty() const;
 
-  void SetDistanceBetweenStop(std::string_view stop_name, int32_t dist);
   /**
-   * @brief Return distance between this stop and other otherwise -1
-   * @param stop_name
-   * @return dist or -1 if no dist
+   * @brief Throws std::out_of_range when there is no such element
    */
-  int32_t GetDistanceBetweenStop(std::string_view stop_name) const;
+  LazyNode operator[](size_t i) const;
+
+  /**
+   * @brief Builds all elements. Long arrays are split into contiguous chunks
+   * of about equal structural count, which are built on up to thread_count
+   * threads and joined in order
+   */
+  Array Materialize(size_t thread_count = 1) const;
+
 private:
-  std::string m_name;
-  geom2d::PointD m_point;
-  std::unordered_map<std::string, int32_t> m_dist;
+  LazyDocument const * m_document;
+  uint32_t m_idx;
 };
-} // namespace bus_model
 
-//------------------------bus_model.cpp---------------------------------------
-namespace bus_model {
-Bus::Bus(std::string _name)
-        : m_name(std::move(_name)) {}
+/**
+ * @brief Keys are compared in place with raw input, values are skipped
+ * until the key matches. First of duplicated keys wins as in Load.
+ * Iteration gives raw keys, escaped ones need DecodeString
+ */
+class LazyMap {
+public:
+  class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<std::string_view, LazyNode>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    Iterator(LazyDocument const & document, uint32_t idx);
+
+    value_type operator*() const;
+    Iterator & operator++();
+    bool operator==(Iterator const & other) const;
+    bool operator!=(Iterator const & other) const;
+
+  private:
+    LazyDocument const * m_document;
+    uint32_t m_idx;
+  };
 
-std::string_view Bus::GetName() const {
-  return m_name;
+  LazyMap(LazyDocument const & document, uint32_t idx);
+
+  Iterator begin() const;
+  Iterator end() const;
+  size_t size() const;
+  bool empty() const;
+
+  Iterator find(std::string_view key) const;
+  size_t count(std::string_view key) const;
+
+  /**
+   * @brief Throws std::out_of_range when there is no such key
+   */
+  LazyNode at(std::string_view key) const;
+
+private:
+  LazyDocument const * m_document;
+  uint32_t m_idx;
+};
+
+/**
+ * @brief Input scanned once into a tape of structural positions and, for each
+ * of them, the index right after the value starting there. Brackets, commas
+ * and colons are checked while building the tape, scalars and escapes
+ * only when the value is touched
+ */
+class LazyDocument {
+public:
+  explicit LazyDocument(std::string input);
+
+  LazyDocument(LazyDocument const &) = delete;
+  LazyDocument & operator=(LazyDocument const &) = delete;
+  LazyDocument(LazyDocument &&) = default;
+  LazyDocument & operator=(LazyDocument &&) = default;
+
+  LazyNode GetRoot() const;
+
+private:
+  friend class LazyNode;
+  friend class LazyArray;
+  friend class LazyMap;
+
+  char At(uint32_t idx) const;
+  void Expect(uint32_t idx, char c) const;
+  uint32_t Skip(uint32_t idx) const;
+  uint32_t NextSibling(uint32_t idx, char close) const;
+  std::string_view RawString(uint32_t idx) const;
+  /**
+   * @brief Text of scalar starting at idx, throws std::bad_variant_access
+   * for strings and containers
+   */
+  std::string_view RawToken(uint32_t idx) const;
+
+  std::string m_input;
+  std::vector<uint32_t> m_positions;
+  std::vector<uint32_t> m_skip;
+};
+
+LazyDocument LoadLazy(std::istream & input);
+
+/**
+ * @brief Same result as Load, root array or arrays directly inside
+ * root map are built with LazyArray::Materialize on thread_count threads
+ */
+Document LoadParallel(std::istream & input, size_t thread_count);
 }
 
-std::vector<std::string> const & Bus::GetRoute() const {
-  return m_route;
+//------------------------json_lazy.cpp---------------------------------------
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <variant>
+
+namespace Json {
+LazyDocument::LazyDocument(std::string input) : m_input(std::move(input)) {
+  if (m_input.size() > UINT32_MAX) {
+    throw ParseError("input is larger than 4 GiB");
+  }
+  StructuralScanner::FindStructurals(m_input, m_positions);
+  if (m_positions.empty()) {
+    throw ParseError("unexpected end of input");
+  }
+
+  // what may come at the next structural, *_OR_CLOSE right after opening bracket
+  enum class Expected {
+    VALUE,
+    VALUE_OR_CLOSE,
+    KEY,
+    KEY_OR_CLOSE,
+    COLON,
+    COMMA_OR_CLOSE,
+    END,
+  };
+  Expected expected = Expected::VALUE;
+  m_skip.resize(m_positions.size());
+  std::vector<uint32_t> open;
+  auto after_value = [&open] {
+    return open.empty() ? Expected::END : Expected::COMMA_OR_CLOSE;
+  };
+  for (uint32_t idx = 0; idx < m_positions.size(); idx++) {
+    char c = m_input[m_positions[idx]];
+    if (expected == Expected::END) {
+      throw ParseError("unexpected data after root value");
+    }
+    bool const is_value_expected = expected == Expected::VALUE || expected == Expected::VALUE_OR_CLOSE;
+    bool is_valid = is_value_expected;
+    if (c == ']' || c == '}') {
+      is_valid = !open.empty() && m_input[m_positions[open.back()]] == (c == ']' ? '[' : '{')
+                 && (expected == Expected::COMMA_OR_CLOSE
+                     || expected == (c == ']' ? Expected::VALUE_OR_CLOSE : Expected::KEY_OR_CLOSE));
+    } else if (c == ',') {
+      is_valid = expected == Expected::COMMA_OR_CLOSE;
+    } else if (c == ':') {
+      is_valid = expected == Expected::COLON;
+    } else if (c == '"') {
+      is_valid = is_value_expected || expected == Expected::KEY || expected == Expected::KEY_OR_CLOSE;
+    }
+    if (!is_valid) {
+      throw ParseError(std::string("unexpected '") + c + "' at " + std::to_string(m_positions[idx]));
+    }
+
+    m_skip[idx] = idx + 1;
+    if (c == '[' || c == '{') {
+      open.push_back(idx);
+      expected = c == '[' ? Expected::VALUE_OR_CLOSE : Expected::KEY_OR_CLOSE;
+    } else if (c == ']' || c == '}') {
+      m_skip[open.back()] = idx + 1;
+      open.pop_back();
+      expected = after_value();
+    } else if (c == ',') {
+      expected = m_input[m_positions[open.back()]] == '[' ? Expected::VALUE : Expected::KEY;
+    } else if (c == ':') {
+      expected = Expected::VALUE;
+    } else if (c == '"') {
+      // closing quote is always the next structural
+      if (idx + 1 == m_positions.size()) {
+        throw ParseError("unterminated string");
+      }
+      m_skip[idx] = idx + 2;
+      m_skip[idx + 1] = idx + 2;
+      ++idx;
+      expected = is_value_expected ? after_value() : Expected::COLON;
+    } else {
+      expected = after_value();
+    }
+  }
+  if (expected != Expected::END) {
+    throw ParseError("unexpected end of input");
+  }
 }
 
-void Bus::SetRoute(std::vector<std::string> route) {
-  m_route = std::move(route);
+LazyNode LazyDocument::GetRoot() const {
+  return LazyNode(*this, 0);
 }
 
-Stop::Stop(std::string _name)
-        : m_name(std::move(_name)) {}
+char LazyDocument::At(uint32_t idx) const {
+  if (idx >= m_positions.size()) {
+    throw ParseError("unexpected end of input");
+  }
+  return m_input[m_positions[idx]];
+}
 
-std::string_view Stop::GetName() const {
-  return m_name;
+void LazyDocument::Expect(uint32_t idx, char c) const {
+  if (At(idx) != c) {
+    throw ParseError(std::string("expected '") + c + "' at " + std::to_string(m_positions[idx]));
+  }
 }
 
-void Stop::SetPoint(geom2d::PointD point) {
-  m_point = point;
+uint32_t LazyDocument::Skip(uint32_t idx) const {
+  At(idx);
+  return m_skip[idx];
 }
 
-geom2d::PointD const & Stop::GetPoint() const {
-  return m_point;
+uint32_t LazyDocument::NextSibling(uint32_t idx, char close) const {
+  uint32_t next = Skip(idx);
+  if (At(next) == ',') {
+    return next + 1;
+  }
+  Expect(next, close);
+  return next;
 }
 
-void Stop::SetDistanceBetweenStop(std::string_view stop_name, int32_t dist) {
-  m_dist[std::string(stop_name)] = dist;
+std::string_view LazyDocument::RawString(uint32_t idx) const {
+  Expect(idx, '"');
+  uint32_t begin = m_positions[idx] + 1;
+  return std::string_view(m_input).substr(begin, m_positions[idx + 1] - begin);
 }
 
-int32_t Stop::GetDistanceBetweenStop(std::string_view stop_name) const {
-  auto it = m_dist.find(std::string(stop_name));
-  if (it != m_dist.end()) {
-    return it->second;
+std::string_view LazyDocument::RawToken(uint32_t idx) const {
+  char c = At(idx);
+  if (c == '"' || c == '[' || c == '{') {
+    throw std::bad_variant_access();
   }
+  uint32_t begin = m_positions[idx];
+  size_t end = m_input.find_first_of(" \t\n\r{}[]:,\"", begin);
+  return std::string_view(m_input).substr(begin, (end == std::string::npos ? m_input.size() : end) - begin);
+}
 
-  return -1;
+namespace {
+Node ParseLazyNumber(std::string_view token) {
+  if (token == "true" || token == "false") {
+    throw std::bad_variant_access();
+  }
+  if (std::optional<Node> node = ParseNumber(token)) {
+    return std::move(*node);
+  }
+  throw ParseError("bad number " + std::string(token));
 }
-} // namespace bus_model
+} // namespace
 
-//------------------------transport_base.hpp---------------------------------
-#include <iostream>
-#include <iomanip>
-#include <sstream>
-#include <unordered_map>
-#include <set>
-#include <optional>
+LazyDocument LoadLazy(std::istream & input) {
+  return LazyDocument(std::string{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()});
+}
 
-namespace{
-static const std::string REQUEST_ID = "request_id";
-static const std::string ERROR_MESSAGE = "error_message";
-static const std::string ROUTE_LENGTH = "route_length";
-static const std::string CURVATURE = "curvature";
-static const std::string STOP_COUNT = "stop_count";
-static const std::string UNIQUE_STOP_COUNT = "unique_stop_count";
-static const std::string BUSES = "buses";
+Document LoadParallel(std::istream & input, size_t thread_count) {
+  LazyDocument document = LoadLazy(input);
+  LazyNode root = document.GetRoot();
+  if (root.IsArray()) {
+    return Document{Node(root.AsArray().Materialize(thread_count))};
+  }
+  if (!root.IsMap()) {
+    return Document{root.Materialize()};
+  }
+  Map result;
+  for (auto [key, value] : root.AsMap()) {
+    result.emplace(DecodeString(key), value.IsArray() ? Node(value.AsArray().Materialize(thread_count)) : value.Materialize());
+  }
+  return Document{Node(std::move(result))};
 }
 
-class Request {
-public:
-  enum class Type {
-    BASE,
-    STAT,
-  };
+LazyNode::LazyNode(LazyDocument const & document, uint32_t idx)
+        : m_document(&document), m_idx(idx) {}
 
-  Request(Type const & type, Json::Node request_body);
+char LazyNode::Front() const {
+  return m_document->At(m_idx);
+}
 
-  Type GetType() const;
-  int32_t GetId() const;
-  Json::Node const & GetRequestBody() const;
-protected:
-  Type m_type;
-  Json::Node m_json;
-};
+bool LazyNode::IsArray() const {
+  return Front() == '[';
+}
 
-class Response {
-public:
-  Response(Json::Node json, int32_t request_id);
+bool LazyNode::IsMap() const {
+  return Front() == '{';
+}
 
-  Json::Node const & GetResponseBody() const;
-private:
-  Json::Node m_json;
-};
+bool LazyNode::IsString() const {
+  return Front() == '"';
+}
 
-std::vector<Request> ParseRequestsJson(std::istream & in);
+LazyArray LazyNode::AsArray() const {
+  if (!IsArray()) {
+    throw std::bad_variant_access();
+  }
+  return LazyArray(*m_document, m_idx);
+}
 
-class TransportBase {
-public:
-  struct BusStat {
-    std::string bus_name;
-    bool is_found = false;
-    int32_t stops_count = 0;
-    int32_t unique_stop_count = 0;
-    int32_t route_length = 0;
-    double curvature = 0;
+LazyMap LazyNode::AsMap() const {
+  if (!IsMap()) {
+    throw std::bad_variant_access();
+  }
+  return LazyMap(*m_document, m_idx);
+}
 
-    Json::Node ToJson() {
-      Json::Map dict;
-      if (is_found) {
-        dict[ROUTE_LENGTH] = Json::Node(route_length);
-        dict[CURVATURE] = Json::Node(curvature);
-        dict[STOP_COUNT] = Json::Node(stops_count);
-        dict[UNIQUE_STOP_COUNT] = Json::Node(unique_stop_count);
-      }
-      else {
-        dict[ERROR_MESSAGE] = Json::Node(std::string("not found"));
-      }
+int32_t LazyNode::AsInt() const {
+  return ParseLazyNumber(m_document->RawToken(m_idx)).AsInt();
+}
 
-      return Json::Node(std::move(dict));
-    }
-  };
+double LazyNode::AsDouble() const {
+  return ParseLazyNumber(m_document->RawToken(m_idx)).AsDouble();
+}
 
-  struct StopStat {
-    std::string stop_name;
-    bool is_found = false;
-    std::vector<std::string> buses;
+bool LazyNode::AsBool() const {
+  std::string_view token = m_document->RawToken(m_idx);
+  if (token == "true" || token == "false") {
+    return token == "true";
+  }
+  ParseLazyNumber(token);
+  throw std::bad_variant_access();
+}
+
+std::string LazyNode::AsString() const {
+  if (!IsString()) {
+    throw std::bad_variant_access();
+  }
+  return DecodeString(m_document->RawString(m_idx));
+}
+
+Node LazyNode::Materialize() const {
+  size_t idx = m_idx;
+  return LoadIndexed(m_document->m_input, m_document->m_positions, idx);
+}
+
+LazyArray::Iterator::Iterator(LazyDocument const & document, uint32_t idx)
+        : m_document(&document), m_idx(idx) {}
+
+LazyNode LazyArray::Iterator::operator*() const {
+  return LazyNode(*m_document, m_idx);
+}
+
+LazyArray::Iterator & LazyArray::Iterator::operator++() {
+  m_idx = m_document->NextSibling(m_idx, ']');
+  return *this;
+}
+
+bool LazyArray::Iterator::operator==(Iterator const & other) const {
+  return m_idx == other.m_idx;
+}
+
+bool LazyArray::Iterator::operator!=(Iterator const & other) const {
+  return !(*this == other);
+}
+
+LazyArray::LazyArray(LazyDocument const & document, uint32_t idx)
+        : m_document(&document), m_idx(idx) {}
+
+LazyArray::Iterator LazyArray::begin() const {
+  return Iterator(*m_document, m_idx + 1);
+}
+
+LazyArray::Iterator LazyArray::end() const {
+  return Iterator(*m_document, m_document->Skip(m_idx) - 1);
+}
+
+size_t LazyArray::size() const {
+  return std::distance(begin(), end());
+}
+
+bool LazyArray::empty() const {
+  return begin() == end();
+}
+
+LazyNode LazyArray::operator[](size_t i) const {
+  Iterator it = begin();
+  Iterator last = end();
+  for (; it != last && i > 0; --i) {
+    ++it;
+  }
+  if (it == last) {
+    throw std::out_of_range("array index is out of range");
+  }
+  return *it;
+}
+
+Array LazyArray::Materialize(size_t thread_count) const {
+  // chunks smaller than this are not worth a thread
+  static constexpr size_t MIN_CHUNK_STRUCTURALS = 1 << 16;
+
+  uint32_t const last = m_document->Skip(m_idx) - 1;
+  std::vector<uint32_t> starts;
+  for (uint32_t idx = m_idx + 1; idx != last; idx = m_document->NextSibling(idx, ']')) {
+    starts.push_back(idx);
+  }
+
+  size_t const span = last - m_idx;
+  size_t const chunk_count = std::clamp<size_t>(span / MIN_CHUNK_STRUCTURALS, 1, std::max<size_t>(thread_count, 1));
+  std::vector<size_t> bounds = {0};
+  for (size_t i = 1; i < starts.size() && bounds.size() < chunk_count; i++) {
+    if (starts[i] - m_idx >= bounds.size() * span / chunk_count) {
+      bounds.push_back(i);
+    }
+  }
+  bounds.push_back(starts.size());
+
+  std::vector<Array> chunks(bounds.size() - 1);
+  std::vector<std::exception_ptr> errors(chunks.size());
+  auto load_chunk = [&](size_t chunk) {
+    try {
+      chunks[chunk].reserve(bounds[chunk + 1] - bounds[chunk]);
+      for (size_t i = bounds[chunk]; i < bounds[chunk + 1]; i++) {
+        chunks[chunk].push_back(LazyNode(*m_document, starts[i]).Materialize());
+      }
+    }
+    catch (...) {
+      errors[chunk] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t chunk = 1; chunk < chunks.size(); chunk++) {
+    workers.emplace_back(load_chunk, chunk);
+  }
+  load_chunk(0);
+  for (std::thread & worker : workers) {
+    worker.join();
+  }
+  for (std::exception_ptr const & error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  if (chunks.size() == 1) {
+    return std::move(chunks.front());
+  }
+  Array result;
+  result.reserve(starts.size());
+  for (Array & chunk : chunks) {
+    std::move(chunk.begin(), chunk.end(), std::back_inserter(result));
+  }
+  return result;
+}
+
+LazyMap::Iterator::Iterator(LazyDocument const & document, uint32_t idx)
+        : m_document(&document), m_idx(idx) {}
+
+LazyMap::Iterator::value_type LazyMap::Iterator::operator*() const {
+  m_document->Expect(m_idx + 2, ':');
+  return {m_document->RawString(m_idx), LazyNode(*m_document, m_idx + 3)};
+}
+
+LazyMap::Iterator & LazyMap::Iterator::operator++() {
+  m_document->Expect(m_idx + 2, ':');
+  m_idx = m_document->NextSibling(m_idx + 3, '}');
+  return *this;
+}
+
+bool LazyMap::Iterator::operator==(Iterator const & other) const {
+  return m_idx == other.m_idx;
+}
+
+bool LazyMap::Iterator::operator!=(Iterator const & other) const {
+  return !(*this == other);
+}
+
+LazyMap::LazyMap(LazyDocument const & document, uint32_t idx)
+        : m_document(&document), m_idx(idx) {}
+
+LazyMap::Iterator LazyMap::begin() const {
+  return Iterator(*m_document, m_idx + 1);
+}
+
+LazyMap::Iterator LazyMap::end() const {
+  return Iterator(*m_document, m_document->Skip(m_idx) - 1);
+}
+
+size_t LazyMap::size() const {
+  return std::distance(begin(), end());
+}
+
+bool LazyMap::empty() const {
+  return begin() == end();
+}
+
+LazyMap::Iterator LazyMap::find(std::string_view key) const {
+  Iterator it = begin();
+  Iterator last = end();
+  for (; it != last; ++it) {
+    std::string_view raw_key = (*it).first;
+    bool const is_escaped = raw_key.find('\\') != std::string_view::npos;
+    if (is_escaped ? DecodeString(raw_key) == key : raw_key == key) {
+      break;
+    }
+  }
+  return it;
+}
+
+size_t LazyMap::count(std::string_view key) const {
+  return find(key) != end() ? 1 : 0;
+}
+
+LazyNode LazyMap::at(std::string_view key) const {
+  Iterator it = find(key);
+  if (it == end()) {
+    throw std::out_of_range("no key " + std::string(key));
+  }
+  return (*it).second;
+}
+}
+
+//------------------------json_ndjson.hpp-------------------------------------
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Json {
+/**
+ * @brief Reads newline delimited documents one at a time. Line buffer and
+ * structural positions keep their capacity between records
+ */
+class NdjsonReader {
+public:
+  explicit NdjsonReader(std::istream & input);
+
+  /**
+   * @brief Loads next record into node, skips blank lines.
+   * Returns false at end of input, throws ParseError for malformed record
+   */
+  bool Next(Node & node);
+
+  size_t GetLineNumber() const;
+
+private:
+  std::istream & m_input;
+  std::string m_line;
+  std::vector<uint32_t> m_positions;
+  size_t m_line_number = 0;
+};
+
+/**
+ * @brief Writes one node per line, lines are collected in a buffer
+ * and flushed when it grows past buffer_size or on destruction
+ */
+class NdjsonWriter {
+public:
+  explicit NdjsonWriter(std::ostream & output, size_t buffer_size = 1 << 16);
+  ~NdjsonWriter();
+
+  NdjsonWriter(NdjsonWriter const &) = delete;
+  NdjsonWriter & operator=(NdjsonWriter const &) = delete;
+
+  void Write(Node const & node);
+  void Flush();
+
+private:
+  std::ostream & m_output;
+  size_t m_buffer_size;
+  std::string m_buffer;
+};
+}
+
+//------------------------json_ndjson.cpp-------------------------------------
+namespace Json {
+NdjsonReader::NdjsonReader(std::istream & input) : m_input(input) {}
+
+bool NdjsonReader::Next(Node & node) {
+  while (std::getline(m_input, m_line)) {
+    ++m_line_number;
+    if (m_line.size() > UINT32_MAX) {
+      throw ParseError("line " + std::to_string(m_line_number) + " is larger than 4 GiB");
+    }
+    StructuralScanner::FindStructurals(m_line, m_positions);
+    if (m_positions.empty()) {
+      continue;
+    }
+    try {
+      size_t idx = 0;
+      node = LoadIndexed(m_line, m_positions, idx);
+      if (idx != m_positions.size()) {
+        throw ParseError("unexpected data after root value");
+      }
+    }
+    catch (ParseError const & error) {
+      throw ParseError("line " + std::to_string(m_line_number) + ": " + error.what());
+    }
+    return true;
+  }
+  return false;
+}
+
+size_t NdjsonReader::GetLineNumber() const {
+  return m_line_number;
+}
+
+NdjsonWriter::NdjsonWriter(std::ostream & output, size_t buffer_size)
+        : m_output(output), m_buffer_size(buffer_size) {
+  m_buffer.reserve(buffer_size);
+}
+
+NdjsonWriter::~NdjsonWriter() {
+  Flush();
+}
+
+void NdjsonWriter::Write(Node const & node) {
+  node.PrintTo(m_buffer);
+  m_buffer += '\n';
+  if (m_buffer.size() >= m_buffer_size) {
+    Flush();
+  }
+}
+
+void NdjsonWriter::Flush() {
+  m_output.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+  m_output.flush();
+  m_buffer.clear();
+}
+}
+
+//------------------------json_schema.hpp-------------------------------------
+#include <array>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Json {
+/**
+ * @brief Binds json key to struct member. Missing required key is an error,
+ * missing optional one leaves member default constructed
+ */
+template <typename Struct, typename Value>
+struct FieldDescriptor {
+  std::string_view key;
+  Value Struct::* member;
+  bool is_required;
+};
+
+template <typename Struct, typename Value>
+constexpr FieldDescriptor<Struct, Value> Field(std::string_view key, Value Struct::* member, bool is_required = true) {
+  return {key, member, is_required};
+}
+
+/**
+ * @brief Specialized for bindable struct with
+ * static constexpr auto fields = std::make_tuple(Field(...), ...);
+ * Members may be int32_t, double, bool, std::string, std::optional, std::vector,
+ * std::map with string keys or other structs with Schema
+ */
+template <typename T>
+struct Schema;
+
+namespace schema_detail {
+template <typename T>
+struct IsOptional : std::false_type {};
+template <typename T>
+struct IsOptional<std::optional<T>> : std::true_type {};
+
+template <typename T>
+struct IsVector : std::false_type {};
+template <typename T>
+struct IsVector<std::vector<T>> : std::true_type {};
+
+template <typename T>
+struct IsStringMap : std::false_type {};
+template <typename T>
+struct IsStringMap<std::map<std::string, T>> : std::true_type {};
+
+constexpr uint64_t HashKey(std::string_view key, uint64_t seed) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+  for (char c : key) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash ^ (hash >> 32);
+}
+
+constexpr size_t KeyTableSize(size_t key_count) {
+  size_t size = 1;
+  while (size < 2 * key_count) {
+    size *= 2;
+  }
+  return size;
+}
+
+/**
+ * @brief Perfect hash of schema keys, seed is searched at compile time
+ */
+template <size_t N>
+struct KeyTable {
+  static constexpr size_t SIZE = KeyTableSize(N);
+
+  uint64_t seed = 0;
+  /// field index + 1, zero for empty slot
+  std::array<uint8_t, SIZE> slots{};
+  std::array<std::string_view, N> keys{};
+  uint64_t required = 0;
+
+  constexpr int Find(std::string_view key) const {
+    uint8_t slot = slots[HashKey(key, seed) & (SIZE - 1)];
+    return slot != 0 && keys[slot - 1] == key ? slot - 1 : -1;
+  }
+};
+
+template <size_t N>
+constexpr KeyTable<N> MakeKeyTable(std::array<std::string_view, N> const & keys, uint64_t required) {
+  static_assert(N <= 64, "schema should have at most 64 fields");
+  KeyTable<N> table{};
+  table.keys = keys;
+  table.required = required;
+  for (table.seed = 0; table.seed < (1 << 16); table.seed++) {
+    table.slots = {};
+    bool is_perfect = true;
+    for (size_t i = 0; i < N && is_perfect; i++) {
+      uint8_t & slot = table.slots[HashKey(keys[i], table.seed) & (KeyTable<N>::SIZE - 1)];
+      is_perfect = slot == 0;
+      slot = static_cast<uint8_t>(i + 1);
+    }
+    if (is_perfect) {
+      return table;
+    }
+  }
+  throw std::logic_error("schema keys should be unique");
+}
+
+template <typename T>
+struct SchemaTable {
+  static constexpr size_t N = std::tuple_size_v<std::decay_t<decltype(Schema<T>::fields)>>;
+
+  static constexpr KeyTable<N> table = MakeKeyTable<N>(
+          std::apply([](auto const &... field) {
+            return std::array<std::string_view, N>{field.key...};
+          }, Schema<T>::fields),
+          std::apply([](auto const &... field) {
+            uint64_t required = 0;
+            size_t i = 0;
+            ((required |= static_cast<uint64_t>(field.is_required) << i++), ...);
+            return required;
+          }, Schema<T>::fields));
+
+  template <typename Func>
+  static void Visit(size_t index, Func && func) {
+    Visit(index, func, std::make_index_sequence<N>());
+  }
+
+  static void CheckRequired(uint64_t seen) {
+    uint64_t missing = table.required & ~seen;
+    for (size_t i = 0; i < N; i++) {
+      if (missing >> i & 1) {
+        throw ParseError("missing field " + std::string(table.keys[i]));
+      }
+    }
+  }
+
+private:
+  template <typename Func, size_t... Is>
+  static void Visit(size_t index, Func & func, std::index_sequence<Is...>) {
+    ((index == Is ? (func(std::get<Is>(Schema<T>::fields)), true) : false) || ...);
+  }
+};
+
+/**
+ * @brief Walks structural positions of text, the source of BindText
+ */
+class TextCursor {
+public:
+  explicit TextCursor(std::string_view input);
+
+  void Expect(char c);
+  /**
+   * @brief Moves past c if it is next
+   */
+  bool Consume(char c);
+  std::string_view ReadString();
+  std::string_view ReadToken();
+  void SkipValue();
+  void ExpectEnd() const;
+
+private:
+  char Peek() const;
+
+  std::string_view m_input;
+  std::vector<uint32_t> m_positions;
+  size_t m_idx = 0;
+};
+
+/**
+ * @brief Value of loaded number node, nullptr when token is not a number
+ */
+template <typename T>
+T ToNumber(Node const * number, std::string_view token) {
+  if constexpr (std::is_same_v<T, int32_t>) {
+    if (!number || !number->IsType<int32_t>()) {
+      throw ParseError("expected int32, got " + std::string(token));
+    }
+    return number->AsInt();
+  } else {
+    if (!number) {
+      throw ParseError("expected number, got " + std::string(token));
+    }
+    return number->AsDouble();
+  }
+}
+
+template <typename T>
+void BindFromText(TextCursor & cursor, T & value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    std::string_view token = cursor.ReadToken();
+    if (token != "true" && token != "false") {
+      throw ParseError("expected bool, got " + std::string(token));
+    }
+    value = token == "true";
+  } else if constexpr (std::is_same_v<T, int32_t> || std::is_same_v<T, double>) {
+    std::string_view token = cursor.ReadToken();
+    std::optional<Node> number = ParseNumber(token);
+    value = ToNumber<T>(number ? &*number : nullptr, token);
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    value = DecodeString(cursor.ReadString());
+  } else if constexpr (IsOptional<T>::value) {
+    BindFromText(cursor, value.emplace());
+  } else if constexpr (IsVector<T>::value) {
+    value.clear();
+    cursor.Expect('[');
+    if (cursor.Consume(']')) {
+      return;
+    }
+    do {
+      BindFromText(cursor, value.emplace_back());
+    } while (cursor.Consume(','));
+    cursor.Expect(']');
+  } else if constexpr (IsStringMap<T>::value) {
+    value.clear();
+    cursor.Expect('{');
+    if (cursor.Consume('}')) {
+      return;
+    }
+    do {
+      std::string key = DecodeString(cursor.ReadString());
+      cursor.Expect(':');
+      typename T::mapped_type item{};
+      BindFromText(cursor, item);
+      value.emplace(std::move(key), std::move(item));
+    } while (cursor.Consume(','));
+    cursor.Expect('}');
+  } else {
+    using Table = SchemaTable<T>;
+    uint64_t seen = 0;
+    cursor.Expect('{');
+    if (!cursor.Consume('}')) {
+      do {
+        std::string_view key = cursor.ReadString();
+        int index = key.find('\\') == std::string_view::npos
+                ? Table::table.Find(key) : Table::table.Find(DecodeString(key));
+        cursor.Expect(':');
+        // first of duplicated keys wins as in Load
+        if (index < 0 || (seen >> index & 1)) {
+          cursor.SkipValue();
+          continue;
+        }
+        seen |= uint64_t(1) << index;
+        Table::Visit(index, [&](auto const & field) {
+          BindFromText(cursor, value.*field.member);
+        });
+      } while (cursor.Consume(','));
+      cursor.Expect('}');
+    }
+    Table::CheckRequired(seen);
+  }
+}
+
+template <typename T>
+void BindFromNode(Node const & node, T & value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    if (!node.IsType<bool>()) {
+      throw ParseError("expected bool, got " + node.ToString());
+    }
+    value = node.AsBool();
+  } else if constexpr (std::is_same_v<T, int32_t> || std::is_same_v<T, double>) {
+    if (!node.IsType<int32_t>() && !node.IsType<double>()) {
+      throw ParseError("expected number, got " + node.ToString());
+    }
+    value = ToNumber<T>(&node, node.ToString());
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    if (!node.IsType<std::string>()) {
+      throw ParseError("expected string, got " + node.ToString());
+    }
+    value = node.AsString();
+  } else if constexpr (IsOptional<T>::value) {
+    BindFromNode(node, value.emplace());
+  } else if constexpr (IsVector<T>::value) {
+    if (!node.IsType<Array>()) {
+      throw ParseError("expected array, got " + node.ToString());
+    }
+    value.clear();
+    value.reserve(node.AsArray().size());
+    for (Node const & item : node.AsArray()) {
+      BindFromNode(item, value.emplace_back());
+    }
+  } else if constexpr (IsStringMap<T>::value) {
+    if (!node.IsType<Map>()) {
+      throw ParseError("expected object, got " + node.ToString());
+    }
+    value.clear();
+    for (auto const & [key, item] : node.AsMap()) {
+      BindFromNode(item, value[key]);
+    }
+  } else {
+    if (!node.IsType<Map>()) {
+      throw ParseError("expected object, got " + node.ToString());
+    }
+    using Table = SchemaTable<T>;
+    uint64_t seen = 0;
+    for (auto const & [key, item] : node.AsMap()) {
+      int index = Table::table.Find(key);
+      if (index < 0) {
+        continue;
+      }
+      seen |= uint64_t(1) << index;
+      Table::Visit(index, [&](auto const & field) {
+        BindFromNode(item, value.*field.member);
+      });
+    }
+    Table::CheckRequired(seen);
+  }
+}
+} // namespace schema_detail
+
+/**
+ * @brief Decodes text straight into T without building nodes,
+ * unknown keys are skipped. Throws ParseError on bad text or missing fields.
+ * Requests reach TransportBase as nodes, which PackCatalogue and servers
+ * also read, so production binds them with BindNode; this is for callers
+ * that still hold the text of one value
+ */
+template <typename T>
+T BindText(std::string_view input) {
+  schema_detail::TextCursor cursor(input);
+  T value{};
+  schema_detail::BindFromText(cursor, value);
+  cursor.ExpectEnd();
+  return value;
+}
+
+/**
+ * @brief Decodes loaded node into T with the same rules as BindText
+ */
+template <typename T>
+T BindNode(Node const & node) {
+  T value{};
+  schema_detail::BindFromNode(node, value);
+  return value;
+}
+}
+
+//------------------------json_schema.cpp-------------------------------------
+namespace Json::schema_detail {
+TextCursor::TextCursor(std::string_view input) : m_input(input) {
+  if (input.size() > UINT32_MAX) {
+    throw ParseError("input is larger than 4 GiB");
+  }
+  StructuralScanner::FindStructurals(input, m_positions);
+}
+
+char TextCursor::Peek() const {
+  if (m_idx >= m_positions.size()) {
+    throw ParseError("unexpected end of input");
+  }
+  return m_input[m_positions[m_idx]];
+}
+
+void TextCursor::Expect(char c) {
+  if (Peek() != c) {
+    throw ParseError(std::string("expected '") + c + "' at " + std::to_string(m_positions[m_idx]));
+  }
+  ++m_idx;
+}
+
+bool TextCursor::Consume(char c) {
+  if (Peek() != c) {
+    return false;
+  }
+  ++m_idx;
+  return true;
+}
+
+std::string_view TextCursor::ReadString() {
+  Expect('"');
+  // closing quote is always the next structural
+  size_t begin = m_positions[m_idx - 1] + 1;
+  Expect('"');
+  return m_input.substr(begin, m_positions[m_idx - 1] - begin);
+}
+
+std::string_view TextCursor::ReadToken() {
+  char c = Peek();
+  if (c == '"' || c == '[' || c == '{' || c == ']' || c == '}' || c == ':' || c == ',') {
+    throw ParseError(std::string("unexpected '") + c + "' at " + std::to_string(m_positions[m_idx]));
+  }
+  size_t begin = m_positions[m_idx++];
+  size_t end = m_input.find_first_of(" \t\n\r{}[]:,\"", begin);
+  return m_input.substr(begin, (end == std::string_view::npos ? m_input.size() : end) - begin);
+}
+
+void TextCursor::SkipValue() {
+  char c = Peek();
+  if (c == '"') {
+    m_idx += 2;
+    return;
+  }
+  if (c != '[' && c != '{') {
+    ReadToken();
+    return;
+  }
+  // quotes inside skipped value go in pairs and brackets in strings are not structurals
+  size_t depth = 0;
+  do {
+    c = Peek();
+    depth += c == '[' || c == '{';
+    depth -= c == ']' || c == '}';
+    ++m_idx;
+  } while (depth != 0);
+}
+
+void TextCursor::ExpectEnd() const {
+  if (m_idx != m_positions.size()) {
+    throw ParseError("unexpected data after root value");
+  }
+}
+}
+
+//------------------------json_cbor.hpp---------------------------------------
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Json {
+/**
+ * @brief Appends node encoded as CBOR (RFC 8949): int32 as integers, doubles
+ * as float64, strings as text strings, containers with definite lengths
+ */
+void EncodeCbor(Node const & node, std::string & output);
+std::string EncodeCbor(Node const & node);
+
+/**
+ * @brief Pull reader of CBOR items, strings are views into the data
+ */
+class CborReader {
+public:
+  enum class Type {
+    INT,
+    DOUBLE,
+    BOOL,
+    STRING,
+    ARRAY,
+    MAP,
+  };
+
+  struct Item {
+    Type type = Type::INT;
+    int64_t as_int = 0;
+    double as_double = 0;
+    bool as_bool = false;
+    std::string_view text;
+    /// count of elements for ARRAY, of key and value pairs for MAP
+    uint64_t size = 0;
+  };
+
+  explicit CborReader(std::string_view data);
+
+  /**
+   * @brief Reads head of next item, elements of containers follow it.
+   * Throws ParseError for truncated data and unsupported items
+   * (null, undefined, tags, byte strings, indefinite lengths)
+   */
+  Item Next();
+
+  bool AtEnd() const;
+
+  size_t BytesLeft() const;
+
+private:
+  uint8_t ReadByte();
+  uint64_t ReadBigEndian(size_t byte_count);
+  uint64_t ReadArgument(uint8_t info);
+
+  std::string_view m_data;
+  size_t m_pos = 0;
+};
+
+/// containers nested deeper are rejected by DecodeCbor before recursion exhausts stack
+constexpr size_t CBOR_MAX_DEPTH = 512;
+
+/**
+ * @brief Builds node from CBOR, integers outside int32_t become doubles as in Load.
+ * Node owns its strings, so text items and map keys are copied out of data,
+ * CborReader gives views for callers that don't need nodes.
+ * Throws ParseError for containers nested deeper than CBOR_MAX_DEPTH
+ */
+Document DecodeCbor(std::string_view data);
+}
+
+//------------------------json_cbor.cpp---------------------------------------
+#include <cmath>
+#include <cstring>
+
+namespace Json {
+namespace {
+enum CborMajor : uint8_t {
+  CBOR_UNSIGNED = 0,
+  CBOR_NEGATIVE = 1,
+  CBOR_BYTES = 2,
+  CBOR_TEXT = 3,
+  CBOR_ARRAY = 4,
+  CBOR_MAP = 5,
+  CBOR_TAG = 6,
+  CBOR_SIMPLE = 7,
+};
+
+constexpr uint8_t CBOR_FALSE = 0xF4;
+constexpr uint8_t CBOR_TRUE = 0xF5;
+constexpr uint8_t CBOR_FLOAT64 = 0xFB;
+
+void WriteBigEndian(uint64_t value, size_t byte_count, std::string & output) {
+  for (size_t i = byte_count; i > 0; i--) {
+    output.push_back(static_cast<char>(value >> (8 * (i - 1))));
+  }
+}
+
+void WriteHead(uint8_t major, uint64_t argument, std::string & output) {
+  uint8_t const type = major << 5;
+  if (argument < 24) {
+    output.push_back(static_cast<char>(type | argument));
+  } else if (argument <= UINT8_MAX) {
+    output.push_back(static_cast<char>(type | 24));
+    WriteBigEndian(argument, 1, output);
+  } else if (argument <= UINT16_MAX) {
+    output.push_back(static_cast<char>(type | 25));
+    WriteBigEndian(argument, 2, output);
+  } else if (argument <= UINT32_MAX) {
+    output.push_back(static_cast<char>(type | 26));
+    WriteBigEndian(argument, 4, output);
+  } else {
+    output.push_back(static_cast<char>(type | 27));
+    WriteBigEndian(argument, 8, output);
+  }
+}
+
+void WriteText(std::string const & text, std::string & output) {
+  WriteHead(CBOR_TEXT, text.size(), output);
+  output += text;
+}
+
+double HalfToDouble(uint16_t half) {
+  int exponent = (half >> 10) & 0x1F;
+  double mantissa = half & 0x3FF;
+  double value = exponent == 0 ? std::ldexp(mantissa, -24)
+          : exponent == 31 ? (mantissa == 0 ? INFINITY : NAN)
+          : std::ldexp(mantissa + 1024, exponent - 25);
+  return half & 0x8000 ? -value : value;
+}
+
+/**
+ * @brief depth is count of containers enclosing the item
+ */
+Node DecodeItem(CborReader & reader, size_t depth) {
+  CborReader::Item item = reader.Next();
+  bool const is_container = item.type == CborReader::Type::ARRAY || item.type == CborReader::Type::MAP;
+  if (is_container && depth >= CBOR_MAX_DEPTH) {
+    throw ParseError("cbor containers are nested deeper than " + std::to_string(CBOR_MAX_DEPTH));
+  }
+  switch (item.type) {
+    case CborReader::Type::INT:
+      if (item.as_int >= INT32_MIN && item.as_int <= INT32_MAX) {
+        return Node(static_cast<int32_t>(item.as_int));
+      }
+      return Node(static_cast<double>(item.as_int));
+    case CborReader::Type::DOUBLE:
+      return Node(item.as_double);
+    case CborReader::Type::BOOL:
+      return Node(item.as_bool);
+    case CborReader::Type::STRING:
+      return Node(std::string(item.text));
+    case CborReader::Type::ARRAY: {
+      Array result;
+      // every element takes at least one byte, so bad sizes do not reserve much
+      result.reserve(std::min<uint64_t>(item.size, reader.BytesLeft()));
+      for (uint64_t i = 0; i < item.size; i++) {
+        result.push_back(DecodeItem(reader, depth + 1));
+      }
+      return Node(std::move(result));
+    }
+    case CborReader::Type::MAP: {
+      Map result;
+      for (uint64_t i = 0; i < item.size; i++) {
+        CborReader::Item key = reader.Next();
+        if (key.type != CborReader::Type::STRING) {
+          throw ParseError("cbor map key is not a text string");
+        }
+        result.emplace(key.text, DecodeItem(reader, depth + 1));
+      }
+      return Node(std::move(result));
+    }
+  }
+  throw ParseError("unknown cbor item");
+}
+} // namespace
+
+void EncodeCbor(Node const & node, std::string & output) {
+  if (node.IsType<Array>()) {
+    WriteHead(CBOR_ARRAY, node.AsArray().size(), output);
+    for (Node const & item : node.AsArray()) {
+      EncodeCbor(item, output);
+    }
+  } else if (node.IsType<Map>()) {
+    WriteHead(CBOR_MAP, node.AsMap().size(), output);
+    for (auto const & [key, item] : node.AsMap()) {
+      WriteText(key, output);
+      EncodeCbor(item, output);
+    }
+  } else if (node.IsType<int32_t>()) {
+    int32_t value = node.AsInt();
+    if (value >= 0) {
+      WriteHead(CBOR_UNSIGNED, static_cast<uint64_t>(value), output);
+    } else {
+      WriteHead(CBOR_NEGATIVE, static_cast<uint64_t>(-1 - static_cast<int64_t>(value)), output);
+    }
+  } else if (node.IsType<double>()) {
+    double value = node.AsDouble();
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    output.push_back(static_cast<char>(CBOR_FLOAT64));
+    WriteBigEndian(bits, 8, output);
+  } else if (node.IsType<bool>()) {
+    output.push_back(static_cast<char>(node.AsBool() ? CBOR_TRUE : CBOR_FALSE));
+  } else {
+    WriteText(node.AsString(), output);
+  }
+}
+
+std::string EncodeCbor(Node const & node) {
+  std::string output;
+  EncodeCbor(node, output);
+  return output;
+}
+
+CborReader::CborReader(std::string_view data) : m_data(data) {}
+
+bool CborReader::AtEnd() const {
+  return m_pos == m_data.size();
+}
+
+size_t CborReader::BytesLeft() const {
+  return m_data.size() - m_pos;
+}
+
+uint8_t CborReader::ReadByte() {
+  if (AtEnd()) {
+    throw ParseError("unexpected end of cbor data");
+  }
+  return static_cast<uint8_t>(m_data[m_pos++]);
+}
+
+uint64_t CborReader::ReadBigEndian(size_t byte_count) {
+  if (BytesLeft() < byte_count) {
+    throw ParseError("unexpected end of cbor data");
+  }
+  uint64_t value = 0;
+  for (size_t i = 0; i < byte_count; i++) {
+    value = (value << 8) | static_cast<uint8_t>(m_data[m_pos++]);
+  }
+  return value;
+}
+
+uint64_t CborReader::ReadArgument(uint8_t info) {
+  if (info < 24) {
+    return info;
+  }
+  if (info > 27) {
+    throw ParseError("indefinite length cbor items are not supported");
+  }
+  return ReadBigEndian(size_t(1) << (info - 24));
+}
+
+CborReader::Item CborReader::Next() {
+  uint8_t const initial = ReadByte();
+  uint8_t const major = initial >> 5;
+  uint8_t const info = initial & 0x1F;
+  Item item;
+
+  if (major == CBOR_SIMPLE) {
+    if (initial == CBOR_FALSE || initial == CBOR_TRUE) {
+      item.type = Type::BOOL;
+      item.as_bool = initial == CBOR_TRUE;
+      return item;
+    }
+    item.type = Type::DOUBLE;
+    if (info == 25) {
+      item.as_double = HalfToDouble(static_cast<uint16_t>(ReadBigEndian(2)));
+    } else if (info == 26) {
+      uint32_t bits = static_cast<uint32_t>(ReadBigEndian(4));
+      float value;
+      std::memcpy(&value, &bits, sizeof(value));
+      item.as_double = value;
+    } else if (info == 27) {
+      uint64_t bits = ReadBigEndian(8);
+      std::memcpy(&item.as_double, &bits, sizeof(item.as_double));
+    } else {
+      throw ParseError("unsupported cbor simple value " + std::to_string(initial));
+    }
+    return item;
+  }
+
+  uint64_t const argument = ReadArgument(info);
+  switch (major) {
+    case CBOR_UNSIGNED:
+    case CBOR_NEGATIVE:
+      if (argument > INT64_MAX) {
+        item.type = Type::DOUBLE;
+        item.as_double = major == CBOR_UNSIGNED ? static_cast<double>(argument) : -1.0 - static_cast<double>(argument);
+      } else {
+        item.as_int = major == CBOR_UNSIGNED ? static_cast<int64_t>(argument) : -1 - static_cast<int64_t>(argument);
+      }
+      return item;
+    case CBOR_TEXT:
+      if (BytesLeft() < argument) {
+        throw ParseError("unexpected end of cbor data");
+      }
+      item.type = Type::STRING;
+      item.text = m_data.substr(m_pos, argument);
+      m_pos += argument;
+      return item;
+    case CBOR_ARRAY:
+    case CBOR_MAP:
+      item.type = major == CBOR_ARRAY ? Type::ARRAY : Type::MAP;
+      item.size = argument;
+      return item;
+    default:
+      throw ParseError("unsupported cbor major type " + std::to_string(major));
+  }
+}
+
+Document DecodeCbor(std::string_view data) {
+  CborReader reader(data);
+  Node root = DecodeItem(reader, 0);
+  if (!reader.AtEnd()) {
+    throw ParseError("unexpected data after root value");
+  }
+  return Document{std::move(root)};
+}
+}
+
+//------------------------geom2d.hpp------------------------------------------
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+namespace geom2d {
+class PointD {
+public:
+  explicit PointD(double _lat, double _lon)
+          : lat(_lat), lon(_lon) {}
+  PointD() = default;
+
+  double GetLat() const {
+    return lat;
+  }
+  double GetLon() const {
+    return lon;
+  }
+private:
+  double lat;
+  double lon;
+};
+
+constexpr int32_t EARTH_RADIUS_KM = 6371;
+constexpr double PI = 3.1415926535;
+
+static double ToRadians(long double degree) {
+  double one_deg = PI / 180.0;
+  return one_deg * degree;
+}
+
+/**
+ * @brief Calculates distance on earth between 2 PointD
+ */
+static double CalculateDistance(PointD const & pt1, PointD const & pt2) {
+  double lat1 = ToRadians(pt1.GetLat());
+  double lon1 = ToRadians(pt1.GetLon());
+  double lat2 = ToRadians(pt2.GetLat());
+  double lon2 = ToRadians(pt2.GetLon());
+
+  double dlon = lon2 - lon1;
+  double dlat = lat2 - lat1;
+
+  long double ans = std::pow(std::sin(dlat / 2), 2) +
+                    std::cos(lat1) * std::cos(lat2) *
+                    std::pow(std::sin(dlon / 2), 2);
+
+  ans = 2 * asin(sqrt(ans));
+
+  // Calculate the result
+  ans *= EARTH_RADIUS_KM;
+
+  //convert to meters
+  ans *= 1000.0;
+
+  return ans;
+}
+
+/**
+ * @brief Calculate ratio between road distance and earth distance
+ * @param dist_road road distance
+ * @param dist_earth earth distance
+ * @return curvature
+ */
+static double CalculateCurvature(int32_t dist_road, long double dist_earth) {
+  return static_cast<double>(dist_road) / dist_earth;
+}
+} // namespace geom2d
+
+//------------------------bus_model.hpp---------------------------------------
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+namespace bus_model {
+class Bus;
+class Stop;
+using BusPtr = std::shared_ptr<Bus>;
+using StopPtr = std::shared_ptr<Stop>;
+
+/**
+ * @brief Route stores only base stop list, the way back of
+ * non-roundtrip route is counted by size() and never stored
+ */
+class Route {
+public:
+  Route() = default;
+  Route(std::vector<std::string> stops, bool is_roundtrip);
+
+  /**
+   * @brief Count of stops in full route (with way back)
+   */
+  size_t size() const;
+
+  std::vector<std::string> const & GetBaseStops() const;
+  bool IsRoundtrip() const;
+private:
+  std::vector<std::string> m_stops;
+  bool m_is_roundtrip = true;
+};
+
+class Bus {
+public:
+  Bus(std::string _name);
+
+  std::string_view GetName() const;
+  Route const & GetRoute() const;
+  void SetRoute(Route route);
+private:
+  std::string m_name;
+  Route m_route;
+};
+
+class Stop {
+public:
+  Stop(std::string _name);
+
+  std::string_view GetName() const;
+  void SetPoint(geom2d::PointD point);
+  geom2d::PointD const & GetPoint() const;
+
+  void SetDistanceBetweenStop(std::string_view stop_name, int32_t dist);
+  /**
+   * @brief Return distance between this stop and other otherwise -1
+   * @param stop_name
+   * @return dist or -1 if no dist
+   */
+  int32_t GetDistanceBetweenStop(std::string_view stop_name) const;
+private:
+  std::string m_name;
+  geom2d::PointD m_point;
+  std::unordered_map<std::string, int32_t> m_dist;
+};
+} // namespace bus_model
+
+//------------------------bus_model.cpp---------------------------------------
+namespace bus_model {
+Route::Route(std::vector<std::string> stops, bool is_roundtrip)
+        : m_stops(std::move(stops)), m_is_roundtrip(is_roundtrip) {}
+
+size_t Route::size() const {
+  if (m_is_roundtrip || m_stops.empty()) {
+    return m_stops.size();
+  }
+  return m_stops.size() * 2 - 1;
+}
+
+std::vector<std::string> const & Route::GetBaseStops() const {
+  return m_stops;
+}
+
+bool Route::IsRoundtrip() const {
+  return m_is_roundtrip;
+}
+
+Bus::Bus(std::string _name)
+        : m_name(std::move(_name)) {}
+
+std::string_view Bus::GetName() const {
+  return m_name;
+}
+
+Route const & Bus::GetRoute() const {
+  return m_route;
+}
+
+void Bus::SetRoute(Route route) {
+  m_route = std::move(route);
+}
+
+Stop::Stop(std::string _name)
+        : m_name(std::move(_name)) {}
+
+std::string_view Stop::GetName() const {
+  return m_name;
+}
+
+void Stop::SetPoint(geom2d::PointD point) {
+  m_point = point;
+}
+
+geom2d::PointD const & Stop::GetPoint() const {
+  return m_point;
+}
+
+void Stop::SetDistanceBetweenStop(std::string_view stop_name, int32_t dist) {
+  m_dist[std::string(stop_name)] = dist;
+}
+
+int32_t Stop::GetDistanceBetweenStop(std::string_view stop_name) const {
+  auto it = m_dist.find(std::string(stop_name));
+  if (it != m_dist.end()) {
+    return it->second;
+  }
+
+  return -1;
+}
+} // namespace bus_model
+
+//------------------------metrics.hpp-----------------------------------------
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace metrics {
+/**
+ * @brief Counters of one request type
+ */
+struct Counters {
+  uint64_t requests = 0;
+  uint64_t hops = 0;
+  /// road distance not set in direct order, reversed one is used
+  uint64_t distance_misses = 0;
+  uint64_t map_lookups = 0;
+  uint64_t allocations = 0;
+  double total_ms = 0;
+  double max_ms = 0;
+
+  Counters & operator+=(Counters const & other);
+  Json::Node ToJson() const;
+};
+
+/**
+ * @brief Catalogue instrumentation: counters per request type and phase timers.
+ * Disabled by default, then scopes and timers neither read clocks nor look up counters
+ */
+class Metrics {
+public:
+  explicit Metrics(bool is_enabled = false);
+
+  bool IsEnabled() const;
+  void SetEnabled(bool is_enabled);
+
+  Counters & GetCounters(std::string const & request_type);
+  void AddPhaseTime(std::string_view phase, double ms);
+  void Merge(Metrics const & other);
+
+  Json::Node ToJson() const;
+private:
+  bool m_is_enabled;
+  std::map<std::string, Counters> m_counters;
+  std::map<std::string, double, std::less<>> m_phase_ms;
+};
+
+/**
+ * @brief Count of operator new calls made by the calling thread so far.
+ * Global operator new is replaced only in builds with COUNT_ALLOCATIONS defined,
+ * otherwise the count stays 0
+ */
+uint64_t AllocationCount();
+
+/**
+ * @brief Adds scope duration to the phase timer, phase must outlive the timer
+ */
+class PhaseTimer {
+public:
+  PhaseTimer(Metrics & metrics, std::string_view phase);
+  ~PhaseTimer();
+private:
+  Metrics & m_metrics;
+  std::string_view m_phase;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+/**
+ * @brief Accounts one request: duration, allocations made by the thread within scope
+ */
+class RequestScope {
+public:
+  RequestScope(Metrics & metrics, std::string const & request_type);
+  ~RequestScope();
+
+  /**
+   * @brief Counters of the request type, scratch ones when metrics are disabled
+   */
+  Counters & GetCounters();
+private:
+  Counters m_scratch;
+  Counters * m_counters;
+  uint64_t m_allocations_start = 0;
+  std::chrono::steady_clock::time_point m_start;
+};
+} // namespace metrics
+
+//------------------------metrics.cpp-----------------------------------------
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined(COUNT_ALLOCATIONS)
+namespace {
+// per thread, so requests answered by concurrent workers see only their own allocations
+thread_local uint64_t g_allocation_count = 0;
+}
+
+// kept out of line, otherwise gcc reports free() of memory returned by operator new
+__attribute__((noinline)) void * operator new(size_t size) {
+  ++g_allocation_count;
+  if (void * ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+// std::get_temporary_buffer of stable_sort allocates by it, it must match delete below too
+__attribute__((noinline)) void * operator new(size_t size, std::nothrow_t const &) noexcept {
+  ++g_allocation_count;
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+__attribute__((noinline)) void operator delete(void * ptr) noexcept {
+  std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void * ptr, size_t) noexcept {
+  std::free(ptr);
+}
+#endif
+
+namespace metrics {
+Counters & Counters::operator+=(Counters const & other) {
+  requests += other.requests;
+  hops += other.hops;
+  distance_misses += other.distance_misses;
+  map_lookups += other.map_lookups;
+  allocations += other.allocations;
+  total_ms += other.total_ms;
+  max_ms = std::max(max_ms, other.max_ms);
+  return *this;
+}
+
+namespace {
+/**
+ * @brief Json integer of counter, nodes hold only int32_t, so larger
+ * counters become doubles, which are exact up to 2^53
+ */
+Json::Node CounterToJson(uint64_t value) {
+  if (value <= static_cast<uint64_t>(INT32_MAX)) {
+    return Json::Node(static_cast<int32_t>(value));
+  }
+  return Json::Node(static_cast<double>(value));
+}
+} // namespace
+
+Json::Node Counters::ToJson() const {
+  Json::Map dict;
+  dict["requests"] = CounterToJson(requests);
+  dict["hops"] = CounterToJson(hops);
+  dict["distance_misses"] = CounterToJson(distance_misses);
+  dict["map_lookups"] = CounterToJson(map_lookups);
+  dict["allocations"] = CounterToJson(allocations);
+  dict["total_ms"] = Json::Node(total_ms);
+  dict["max_ms"] = Json::Node(max_ms);
+  return Json::Node(std::move(dict));
+}
+
+Metrics::Metrics(bool is_enabled)
+        : m_is_enabled(is_enabled) {}
+
+bool Metrics::IsEnabled() const {
+  return m_is_enabled;
+}
+
+void Metrics::SetEnabled(bool is_enabled) {
+  m_is_enabled = is_enabled;
+}
+
+Counters & Metrics::GetCounters(std::string const & request_type) {
+  return m_counters[request_type];
+}
+
+void Metrics::AddPhaseTime(std::string_view phase, double ms) {
+  auto it = m_phase_ms.find(phase);
+  if (it == m_phase_ms.end()) {
+    it = m_phase_ms.emplace(std::string(phase), 0.0).first;
+  }
+  it->second += ms;
+}
+
+void Metrics::Merge(Metrics const & other) {
+  for (auto const & [type, counters] : other.m_counters) {
+    m_counters[type] += counters;
+  }
+  for (auto const & [phase, ms] : other.m_phase_ms) {
+    AddPhaseTime(phase, ms);
+  }
+}
+
+Json::Node Metrics::ToJson() const {
+  Json::Map requests;
+  for (auto const & [type, counters] : m_counters) {
+    requests[type] = counters.ToJson();
+  }
+  Json::Map phases;
+  for (auto const & [phase, ms] : m_phase_ms) {
+    phases[phase] = Json::Node(ms);
+  }
+
+  Json::Map dict;
+  dict["requests"] = Json::Node(std::move(requests));
+  dict["phases_ms"] = Json::Node(std::move(phases));
+  return Json::Node(std::move(dict));
+}
+
+uint64_t AllocationCount() {
+#if defined(COUNT_ALLOCATIONS)
+  return g_allocation_count;
+#else
+  return 0;
+#endif
+}
+
+PhaseTimer::PhaseTimer(Metrics & metrics, std::string_view phase)
+        : m_metrics(metrics), m_phase(phase) {
+  if (m_metrics.IsEnabled()) {
+    m_start = std::chrono::steady_clock::now();
+  }
+}
+
+PhaseTimer::~PhaseTimer() {
+  if (!m_metrics.IsEnabled()) {
+    return;
+  }
+  auto dur = std::chrono::steady_clock::now() - m_start;
+  m_metrics.AddPhaseTime(m_phase, std::chrono::duration<double, std::milli>(dur).count());
+}
+
+RequestScope::RequestScope(Metrics & metrics, std::string const & request_type)
+        : m_counters(&m_scratch) {
+  if (!metrics.IsEnabled()) {
+    return;
+  }
+  m_counters = &metrics.GetCounters(request_type);
+  ++m_counters->requests;
+  m_allocations_start = AllocationCount();
+  m_start = std::chrono::steady_clock::now();
+}
+
+RequestScope::~RequestScope() {
+  if (m_counters == &m_scratch) {
+    return;
+  }
+  auto dur = std::chrono::steady_clock::now() - m_start;
+  double ms = std::chrono::duration<double, std::milli>(dur).count();
+  m_counters->total_ms += ms;
+  m_counters->max_ms = std::max(m_counters->max_ms, ms);
+  m_counters->allocations += AllocationCount() - m_allocations_start;
+}
+
+Counters & RequestScope::GetCounters() {
+  return *m_counters;
+}
+} // namespace metrics
+
+//------------------------transport_base.hpp---------------------------------
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+#include <set>
+#include <optional>
+
+namespace{
+static const std::string REQUEST_ID = "request_id";
+static const std::string ERROR_MESSAGE = "error_message";
+static const std::string ROUTE_LENGTH = "route_length";
+static const std::string CURVATURE = "curvature";
+static const std::string STOP_COUNT = "stop_count";
+static const std::string UNIQUE_STOP_COUNT = "unique_stop_count";
+static const std::string BUSES = "buses";
+}
+
+class Request {
+public:
+  enum class Type {
+    BASE,
+    STAT,
+  };
+
+  Request(Type const & type, Json::Node request_body);
+
+  Type GetType() const;
+  int32_t GetId() const;
+  Json::Node const & GetRequestBody() const;
+protected:
+  Type m_type;
+  Json::Node m_json;
+};
+
+class Response {
+public:
+  Response(Json::Node json, int32_t request_id);
+
+  Json::Node const & GetResponseBody() const;
+private:
+  Json::Node m_json;
+};
+
+/**
+ * @brief Body of base request and of stat request about bus
+ */
+struct BusRequestBody {
+  std::string name;
+  std::optional<std::vector<std::string>> stops;
+  bool is_roundtrip = false;
+};
+
+/**
+ * @brief Body of base request and of stat request about stop,
+ * stat requests have id instead of coordinates
+ */
+struct StopRequestBody {
+  std::string name;
+  std::optional<int32_t> id;
+  std::optional<double> latitude;
+  std::optional<double> longitude;
+  std::map<std::string, int32_t> road_distances;
+};
+
+template <>
+struct Json::Schema<BusRequestBody> {
+  static constexpr auto fields = std::make_tuple(
+          Json::Field("name", &BusRequestBody::name),
+          Json::Field("stops", &BusRequestBody::stops, false),
+          Json::Field("is_roundtrip", &BusRequestBody::is_roundtrip, false));
+};
+
+template <>
+struct Json::Schema<StopRequestBody> {
+  static constexpr auto fields = std::make_tuple(
+          Json::Field("name", &StopRequestBody::name),
+          Json::Field("id", &StopRequestBody::id, false),
+          Json::Field("latitude", &StopRequestBody::latitude, false),
+          Json::Field("longitude", &StopRequestBody::longitude, false),
+          Json::Field("road_distances", &StopRequestBody::road_distances, false));
+};
+
+std::vector<Request> ParseRequestsJson(std::istream & in);
+void PrintResponses(std::ostream & out, std::vector<Response> responses);
+
+/**
+ * @brief Read-only part of catalogue used to answer stat requests
+ */
+class StatCatalogue {
+public:
+  virtual ~StatCatalogue() = default;
+
+  /**
+   * @brief Answers one stat request without modifying the base,
+   * safe to call concurrently with own metrics object per thread
+   */
+  virtual Response AnswerStatRequest(Request const & request, metrics::Metrics & metrics) const = 0;
+};
+
+class TransportBase : public StatCatalogue {
+public:
+  struct BusStat {
+    std::string bus_name;
+    bool is_found = false;
+    int32_t stops_count = 0;
+    int32_t unique_stop_count = 0;
+    int32_t route_length = 0;
+    double curvature = 0;
+
+    Json::Node ToJson() {
+      Json::Map dict;
+      if (is_found) {
+        dict[ROUTE_LENGTH] = Json::Node(route_length);
+        dict[CURVATURE] = Json::Node(curvature);
+        dict[STOP_COUNT] = Json::Node(stops_count);
+        dict[UNIQUE_STOP_COUNT] = Json::Node(unique_stop_count);
+      }
+      else {
+        dict[ERROR_MESSAGE] = Json::Node(std::string("not found"));
+      }
+
+      return Json::Node(std::move(dict));
+    }
+  };
+
+  struct StopStat {
+    std::string stop_name;
+    bool is_found = false;
+    std::vector<std::string> buses;
 
     Json::Node ToJson() const {
       Json::Map dict;
       if (is_found) {
         dict[BUSES] = std::vector<Json::Node>(buses.begin(), buses.end());
       }
-      else {
-        dict[ERROR_MESSAGE] = Json::Node(std::string("not found"));
+      else {
+        dict[ERROR_MESSAGE] = Json::Node(std::string("not found"));
+      }
+
+      return Json::Node(std::move(dict));
+    }
+  };
+
+  std::vector<Response> ConsumeRequests(std::vector<Request> requests);
+
+  Response AnswerStatRequest(Request const & request, metrics::Metrics & metrics) const override;
+
+  /**
+   * @brief Counters and phase timers collected by this catalogue
+   */
+  metrics::Metrics & GetMetrics();
+  metrics::Metrics const & GetMetrics() const;
+
+  /**
+   * @brief Bind loaded body of request with BindNode, text of requests
+   * is not kept after ParseRequestsJson
+   */
+  bus_model::BusPtr ParseBus(Request const & request) const;
+  bus_model::StopPtr ParseStop(Request const & request) const;
+  std::vector<std::string> ParseStopByDel(std::string_view stops, char del);
+
+private:
+  /**
+   * @brief Add Bus with route
+   */
+  void AddBus(bus_model::BusPtr bus);
+
+  /**
+   * @brief Add Stop with point
+   */
+  void AddStop(bus_model::StopPtr stop);
+
+  BusStat CalculateStatForBus(std::string_view bus_name, metrics::Counters & counters) const;
+  StopStat CalculateStatForStop(std::string_view stop_name, metrics::Counters & counters) const;
+
+  /**
+   * @brief Road distance from -> to, if not set uses distance to -> from
+   */
+  int32_t GetRoadDistance(bus_model::Stop const & from, bus_model::Stop const & to,
+                          metrics::Counters & counters) const;
+
+  /**
+   * @brief adds bus_name in all stop objects related with bus
+   *
+   */
+  void UpdateStops(std::string_view bus_name);
+
+  metrics::Counters & CurrentCounters();
+
+private:
+  std::unordered_map<std::string_view, bus_model::BusPtr> m_buses;
+  std::unordered_map<std::string_view, bus_model::StopPtr> m_stops;
+
+  std::unordered_map<std::string_view, std::set<std::string_view>> m_stop_name_and_bus_names;
+
+  metrics::Metrics m_metrics;
+  /// counters of request being processed
+  metrics::Counters * m_current_counters = nullptr;
+  /// collects counters of calls made outside of ConsumeRequests
+  metrics::Counters m_idle_counters;
+};
+
+//------------------------transport_base.cpp---------------------------------
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+static const std::string ID = "id";
+static const std::string TYPE = "type";
+static const std::string BUS_STR = "Bus";
+static const std::string BASE_REQUESTS = "base_requests";
+static const std::string STAT_REQUESTS = "stat_requests";
+static const std::string NAME = "name";
+static const std::string STOPS = "stops";
+static const std::string IS_ROUNDTRIP = "is_roundtrip";
+static const std::string ROAD_DISTANCES = "road_distances";
+static const std::string LONGITUDE = "longitude";
+static const std::string LATITUDE = "latitude";
+
+static const std::string BUS_BASE_METRIC = "bus_base";
+static const std::string STOP_BASE_METRIC = "stop_base";
+static const std::string BUS_STAT_METRIC = "bus_stat";
+static const std::string STOP_STAT_METRIC = "stop_stat";
+static const std::string BUILD_PHASE = "build";
+static const std::string QUERY_PHASE = "query";
+}
+
+Request::Request(Type const & type, Json::Node json)
+        : m_type(type), m_json(std::move(json)) {}
+
+Request::Type Request::GetType() const {
+  return m_type;
+}
+
+int32_t Request::GetId() const {
+  return m_json.AsMap().at(ID).AsInt();
+}
+
+Json::Node const & Request::GetRequestBody() const {
+  return m_json;
+}
+
+Response::Response(Json::Node json, int32_t request_id)
+        : m_json(std::move(json)) {
+  m_json.AddValue(Json::Node(request_id), REQUEST_ID);
+}
+
+Json::Node const & Response::GetResponseBody() const {
+  return m_json;
+}
+
+void PrintResponses(std::ostream & out, std::vector<Response> responses) {
+  Json::Node result_response;
+  for (auto const & response : responses) {
+    result_response.AddValue(response.GetResponseBody());
+  }
+  out << result_response.ToString();
+}
+
+std::vector<Request> ParseRequestsJson(std::istream & in) {
+  using namespace Json;
+  // every request is bound later, so they are loaded eagerly with arrays split between threads
+  Document document = LoadParallel(in, std::thread::hardware_concurrency());
+  Map & requests_dict = document.GetRoot().AsMap();
+  std::vector<Request> requests;
+
+  auto ParseRequestsFunc = [](std::string const & requests_key, Request::Type request_type,
+                              Map & _requests_dict, std::vector<Request> & _requests)
+  -> void {
+    auto it = _requests_dict.find(requests_key);
+    if (it == _requests_dict.end()) {
+      return;
+    }
+    for (Node & req : it->second.AsArray()) {
+      _requests.emplace_back(request_type, std::move(req));
+    }
+  };
+
+  ParseRequestsFunc(BASE_REQUESTS, Request::Type::BASE, requests_dict, requests);
+  ParseRequestsFunc(STAT_REQUESTS, Request::Type::STAT, requests_dict, requests);
+
+  return requests;
+}
+
+void TransportBase::AddBus(bus_model::BusPtr bus) {
+  ++CurrentCounters().map_lookups;
+  m_buses[bus->GetName()] = bus;
+  UpdateStops(bus->GetName());
+}
+
+void TransportBase::AddStop(bus_model::StopPtr stop) {
+  CurrentCounters().map_lookups += 2;
+  m_stops[stop->GetName()] = stop;
+  m_stop_name_and_bus_names[stop->GetName()];
+}
+
+std::vector<Response> TransportBase::ConsumeRequests(std::vector<Request> requests) {
+  std::vector<Response> responses;
+  for (Request const & request : requests) {
+    bool const is_bus = request.GetRequestBody().AsMap().find(TYPE)->second.AsString() == BUS_STR;
+    switch (request.GetType()) {
+      case Request::Type::BASE:
+      {
+        metrics::PhaseTimer timer(m_metrics, BUILD_PHASE);
+        metrics::RequestScope scope(m_metrics, is_bus ? BUS_BASE_METRIC : STOP_BASE_METRIC);
+        m_current_counters = &scope.GetCounters();
+        if (is_bus) {
+          AddBus(ParseBus(request));
+        }
+        else {
+          AddStop(ParseStop(request));
+        }
+      }
+        break;
+      case Request::Type::STAT:
+      {
+        metrics::PhaseTimer timer(m_metrics, QUERY_PHASE);
+        responses.push_back(AnswerStatRequest(request, m_metrics));
+      }
+        break;
+    }
+    m_current_counters = nullptr;
+  }
+
+  return responses;
+}
+
+Response TransportBase::AnswerStatRequest(Request const & request, metrics::Metrics & metrics) const {
+  bool const is_bus = request.GetRequestBody().AsMap().find(TYPE)->second.AsString() == BUS_STR;
+  metrics::RequestScope scope(metrics, is_bus ? BUS_STAT_METRIC : STOP_STAT_METRIC);
+  metrics::Counters & counters = scope.GetCounters();
+  if (is_bus) {
+    return Response(CalculateStatForBus(ParseBus(request)->GetName(), counters).ToJson(), request.GetId());
+  }
+  return Response(CalculateStatForStop(ParseStop(request)->GetName(), counters).ToJson(), request.GetId());
+}
+
+metrics::Counters & TransportBase::CurrentCounters() {
+  return m_current_counters ? *m_current_counters : m_idle_counters;
+}
+
+metrics::Metrics & TransportBase::GetMetrics() {
+  return m_metrics;
+}
+
+metrics::Metrics const & TransportBase::GetMetrics() const {
+  return m_metrics;
+}
+
+TransportBase::BusStat TransportBase::CalculateStatForBus(std::string_view bus_name,
+                                                          metrics::Counters & counters) const {
+  ++counters.map_lookups;
+  auto it = m_buses.find(bus_name);
+  if (it != m_buses.end()) {
+    bus_model::Route const & route = it->second->GetRoute();
+    bool const is_roundtrip = route.IsRoundtrip();
+    std::unordered_set<std::string_view> s;
+    long double dist_earth = 0.0;
+    int32_t dist_road = 0.0;
+    bus_model::StopPtr prev_stop = nullptr;
+    for (auto const & stop_name : route.GetBaseStops()) {
+      ++counters.map_lookups;
+      bus_model::StopPtr stop = m_stops.find(stop_name)->second;
+      if (prev_stop) {
+        ++counters.hops;
+        dist_road += GetRoadDistance(*prev_stop, *stop, counters);
+        long double hop_earth = geom2d::CalculateDistance(prev_stop->GetPoint(), stop->GetPoint());
+        dist_earth += hop_earth;
+
+        if (!is_roundtrip) {
+          // way back hop of linear route
+          ++counters.hops;
+          dist_road += GetRoadDistance(*stop, *prev_stop, counters);
+          dist_earth += hop_earth;
+        }
+      }
+      prev_stop = stop;
+      s.insert(stop->GetName());
+    }
+
+    return {.bus_name = std::string(bus_name),
+            .is_found = true,
+            .stops_count = static_cast<int32_t>(route.size()),
+            .unique_stop_count = static_cast<int32_t>(s.size()),
+            .route_length = dist_road,
+            .curvature = geom2d::CalculateCurvature(dist_road, dist_earth)};
+  }
+
+  return {.bus_name = std::string(bus_name),
+          .is_found = false};
+}
+
+int32_t TransportBase::GetRoadDistance(bus_model::Stop const & from, bus_model::Stop const & to,
+                                       metrics::Counters & counters) const {
+  ++counters.map_lookups;
+  int32_t dist = from.GetDistanceBetweenStop(to.GetName());
+  if (dist == -1) {
+    ++counters.map_lookups;
+    ++counters.distance_misses;
+    return to.GetDistanceBetweenStop(from.GetName());
+  }
+  return dist;
+}
+
+TransportBase::StopStat TransportBase::CalculateStatForStop(std::string_view stop_name,
+                                                            metrics::Counters & counters) const {
+  ++counters.map_lookups;
+  auto it = m_stop_name_and_bus_names.find(stop_name);
+  if (it != m_stop_name_and_bus_names.end()) {
+    std::vector<std::string> buses(it->second.begin(), it->second.end());
+    return {.stop_name = std::string(stop_name),
+            .is_found = true,
+            .buses = std::move(buses)};
+  }
+
+  return {.stop_name = std::string(stop_name),
+          .is_found = false,
+          .buses = {}};
+}
+
+void TransportBase::UpdateStops(std::string_view bus_name) {
+  metrics::Counters & counters = CurrentCounters();
+  ++counters.map_lookups;
+  auto bus_it = m_buses.find(bus_name);
+  if (bus_it != m_buses.end()) {
+    auto const & route = bus_it->second->GetRoute();
+    counters.map_lookups += route.GetBaseStops().size();
+    for (std::string_view stop_name : route.GetBaseStops()) {
+      m_stop_name_and_bus_names[stop_name].insert(bus_name);
+    }
+  }
+}
+
+bus_model::BusPtr TransportBase::ParseBus(Request const & request) const {
+  BusRequestBody body = Json::BindNode<BusRequestBody>(request.GetRequestBody());
+  bus_model::BusPtr bus = std::make_shared<bus_model::Bus>(std::move(body.name));
+
+  if (body.stops) {
+    bus->SetRoute(bus_model::Route(std::move(*body.stops), body.is_roundtrip));
+  }
+
+  return bus;
+}
+
+bus_model::StopPtr TransportBase::ParseStop(Request const & request) const {
+  StopRequestBody body = Json::BindNode<StopRequestBody>(request.GetRequestBody());
+  bus_model::StopPtr stop = std::make_shared<bus_model::Stop>(std::move(body.name));
+
+  if (!body.id) {
+    if (!body.latitude || !body.longitude) {
+      throw Json::ParseError("stop " + std::string(stop->GetName()) + " has no coordinates");
+    }
+    stop->SetPoint(geom2d::PointD(*body.latitude, *body.longitude));
+    for (auto const & [name, dist] : body.road_distances) {
+      stop->SetDistanceBetweenStop(name, dist);
+    }
+  }
+
+  return stop;
+}
+
+//------------------------bench.hpp-------------------------------------------
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bench {
+/**
+ * @brief Parameters of synthetic transport network
+ */
+struct NetworkConfig {
+  uint64_t seed = 42;
+  int32_t stop_count = 1000;
+  int32_t bus_count = 100;
+  int32_t route_length = 20;
+  /// share of route stops taken from the common hub stops
+  double overlap = 0.3;
+  /// share of hops whose road distance is set in direct order (other are set reversed)
+  double road_distance_share = 0.5;
+  /// share of non-roundtrip buses
+  double linear_share = 0.5;
+  int32_t stat_count = 1000;
+  /// share of Bus stat requests (other are Stop)
+  double bus_query_share = 0.5;
+  /// share of stat requests for unknown objects
+  double miss_share = 0.05;
+};
+
+/**
+ * @brief Parses "key=value" options, unknown keys raise std::invalid_argument
+ */
+NetworkConfig ParseNetworkConfig(std::vector<std::string_view> const & args);
+
+/**
+ * @brief Generates base_requests and stat_requests json document
+ */
+void GenerateNetworkJson(NetworkConfig const & config, std::ostream & out);
+
+struct PhaseTimes {
+  double generate_ms = 0;
+  double parse_ms = 0;
+  double build_ms = 0;
+  double query_ms = 0;
+  double serialize_ms = 0;
+};
+
+struct LatencyStat {
+  double p50_us = 0;
+  double p90_us = 0;
+  double p99_us = 0;
+  double max_us = 0;
+  double throughput_rps = 0;
+};
+
+/**
+ * @brief Measures TransportBase phases on generated network and prints report
+ */
+void RunBenchmark(NetworkConfig const & config, std::ostream & out);
+} // namespace bench
+
+//------------------------bench.cpp-------------------------------------------
+#include <algorithm>
+#include <stdexcept>
+
+namespace bench {
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double ElapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double Percentile(std::vector<double> const & sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+std::string StopName(int32_t idx) {
+  return "Stop " + std::to_string(idx);
+}
+
+std::string BusName(int32_t idx) {
+  return "Bus " + std::to_string(idx);
+}
+} // namespace
+
+NetworkConfig ParseNetworkConfig(std::vector<std::string_view> const & args) {
+  NetworkConfig config;
+  for (std::string_view arg : args) {
+    size_t pos = arg.find('=');
+    if (pos == std::string_view::npos) {
+      throw std::invalid_argument("expected key=value, got " + std::string(arg));
+    }
+    std::string_view key = arg.substr(0, pos);
+    std::string value(arg.substr(pos + 1));
+
+    if (key == "seed") {
+      config.seed = std::stoull(value);
+    } else if (key == "stops") {
+      config.stop_count = std::stoi(value);
+    } else if (key == "buses") {
+      config.bus_count = std::stoi(value);
+    } else if (key == "route_length") {
+      config.route_length = std::stoi(value);
+    } else if (key == "overlap") {
+      config.overlap = std::stod(value);
+    } else if (key == "road_share") {
+      config.road_distance_share = std::stod(value);
+    } else if (key == "linear_share") {
+      config.linear_share = std::stod(value);
+    } else if (key == "stats") {
+      config.stat_count = std::stoi(value);
+    } else if (key == "bus_query_share") {
+      config.bus_query_share = std::stod(value);
+    } else if (key == "miss_share") {
+      config.miss_share = std::stod(value);
+    } else {
+      throw std::invalid_argument("unknown option " + std::string(key));
+    }
+  }
+
+  // closing stop of roundtrip route needs two other stops to differ from
+  if (config.stop_count < 3 || config.route_length < 2) {
+    throw std::invalid_argument("stops must be at least 3 and route_length at least 2");
+  }
+  return config;
+}
+
+void GenerateNetworkJson(NetworkConfig const & config, std::ostream & out) {
+  std::mt19937_64 rng(config.seed);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::uniform_real_distribution<double> lat_dist(55.5, 56.0);
+  std::uniform_real_distribution<double> lon_dist(37.3, 37.9);
+  std::uniform_int_distribution<int32_t> stop_dist(0, config.stop_count - 1);
+  int32_t const hub_count = std::max(1, config.stop_count / 10);
+  std::uniform_int_distribution<int32_t> hub_dist(0, hub_count - 1);
+
+  std::vector<geom2d::PointD> points;
+  points.reserve(config.stop_count);
+  for (int32_t i = 0; i < config.stop_count; i++) {
+    points.emplace_back(lat_dist(rng), lon_dist(rng));
+  }
+
+  // every hop gets road distance set in one of directions
+  std::vector<std::vector<std::pair<int32_t, int32_t>>> road_distances(config.stop_count);
+  std::vector<std::vector<int32_t>> routes(config.bus_count);
+  std::vector<bool> roundtrips(config.bus_count);
+  for (int32_t bus = 0; bus < config.bus_count; bus++) {
+    auto & route = routes[bus];
+    roundtrips[bus] = unit(rng) >= config.linear_share;
+    // roundtrip route is closed by its first stop, which must differ from the stop before it
+    int32_t const open_length = roundtrips[bus] ? std::max(config.route_length - 1, 2) : config.route_length;
+    while (static_cast<int32_t>(route.size()) < open_length) {
+      int32_t stop = unit(rng) < config.overlap ? hub_dist(rng) : stop_dist(rng);
+      if (!route.empty() && route.back() == stop) {
+        continue;
+      }
+      if (roundtrips[bus] && static_cast<int32_t>(route.size()) + 1 == open_length && route.front() == stop) {
+        continue;
+      }
+      route.push_back(stop);
+    }
+    if (roundtrips[bus]) {
+      route.push_back(route.front());
+    }
+
+    for (size_t i = 1; i < route.size(); i++) {
+      int32_t from = route[i - 1];
+      int32_t to = route[i];
+      double earth = geom2d::CalculateDistance(points[from], points[to]);
+      int32_t road = static_cast<int32_t>(earth * (1.0 + unit(rng) * 0.5)) + 1;
+      if (unit(rng) < config.road_distance_share) {
+        road_distances[from].emplace_back(to, road);
+      } else {
+        road_distances[to].emplace_back(from, road);
+      }
+    }
+  }
+
+  out << std::fixed << std::setprecision(6);
+  out << "{\"base_requests\": [";
+  bool first = true;
+  for (int32_t i = 0; i < config.stop_count; i++) {
+    out << (first ? "" : ", ");
+    first = false;
+    out << "{\"type\": \"Stop\", \"name\": \"" << StopName(i) << "\", "
+        << "\"latitude\": " << points[i].GetLat() << ", "
+        << "\"longitude\": " << points[i].GetLon() << ", "
+        << "\"road_distances\": {";
+    // keys of road_distances object must be unique
+    std::sort(road_distances[i].begin(), road_distances[i].end());
+    road_distances[i].erase(std::unique(road_distances[i].begin(), road_distances[i].end(),
+                                        [](auto const & lhs, auto const & rhs) {
+                                          return lhs.first == rhs.first;
+                                        }),
+                            road_distances[i].end());
+    for (size_t j = 0; j < road_distances[i].size(); j++) {
+      out << (j ? ", " : "") << "\"" << StopName(road_distances[i][j].first) << "\": "
+          << road_distances[i][j].second;
+    }
+    out << "}}";
+  }
+  for (int32_t bus = 0; bus < config.bus_count; bus++) {
+    out << ", {\"type\": \"Bus\", \"name\": \"" << BusName(bus) << "\", \"stops\": [";
+    for (size_t j = 0; j < routes[bus].size(); j++) {
+      out << (j ? ", " : "") << "\"" << StopName(routes[bus][j]) << "\"";
+    }
+    out << "], \"is_roundtrip\": " << (roundtrips[bus] ? "true" : "false") << "}";
+  }
+
+  out << "], \"stat_requests\": [";
+  std::uniform_int_distribution<int32_t> bus_dist(0, std::max(0, config.bus_count - 1));
+  for (int32_t id = 0; id < config.stat_count; id++) {
+    bool is_bus = unit(rng) < config.bus_query_share && config.bus_count > 0;
+    bool is_miss = unit(rng) < config.miss_share;
+    std::string name;
+    if (is_miss) {
+      name = is_bus ? BusName(config.bus_count + id) : StopName(config.stop_count + id);
+    } else {
+      name = is_bus ? BusName(bus_dist(rng)) : StopName(stop_dist(rng));
+    }
+    out << (id ? ", " : "") << "{\"id\": " << id + 1 << ", \"type\": \""
+        << (is_bus ? "Bus" : "Stop") << "\", \"name\": \"" << name << "\"}";
+  }
+  out << "]}";
+}
+
+void RunBenchmark(NetworkConfig const & config, std::ostream & out) {
+  PhaseTimes times;
+
+  auto start = Clock::now();
+  std::stringstream input;
+  GenerateNetworkJson(config, input);
+  times.generate_ms = ElapsedMs(start);
+  size_t const input_size = input.str().size();
+
+  start = Clock::now();
+  std::vector<Request> requests = ParseRequestsJson(input);
+  times.parse_ms = ElapsedMs(start);
+
+  auto stat_begin = std::partition(requests.begin(), requests.end(), [](Request const & request) {
+    return request.GetType() == Request::Type::BASE;
+  });
+  std::vector<Request> base_requests(requests.begin(), stat_begin);
+  std::vector<Request> stat_requests(stat_begin, requests.end());
+
+  // latency is measured on its own copy, so its requests don't count in metrics of the report
+  TransportBase latency_tb;
+  latency_tb.ConsumeRequests(base_requests);
+
+  TransportBase tb;
+  tb.GetMetrics().SetEnabled(true);
+  start = Clock::now();
+  tb.ConsumeRequests(std::move(base_requests));
+  times.build_ms = ElapsedMs(start);
+
+  start = Clock::now();
+  std::vector<Response> responses = tb.ConsumeRequests(stat_requests);
+  times.query_ms = ElapsedMs(start);
+
+  start = Clock::now();
+  std::ostringstream output;
+  PrintResponses(output, std::move(responses));
+  times.serialize_ms = ElapsedMs(start);
+
+  // latency of single request batches
+  std::vector<double> latencies;
+  latencies.reserve(stat_requests.size());
+  for (Request const & request : stat_requests) {
+    auto request_start = Clock::now();
+    latency_tb.ConsumeRequests({request});
+    latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - request_start).count());
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  LatencyStat latency;
+  latency.p50_us = Percentile(latencies, 0.5);
+  latency.p90_us = Percentile(latencies, 0.9);
+  latency.p99_us = Percentile(latencies, 0.99);
+  latency.max_us = latencies.empty() ? 0 : latencies.back();
+  latency.throughput_rps = times.query_ms > 0 ? stat_requests.size() / (times.query_ms / 1000.0) : 0;
+
+  out << std::fixed << std::setprecision(3);
+  out << "seed: " << config.seed << ", stops: " << config.stop_count
+      << ", buses: " << config.bus_count << ", route_length: " << config.route_length
+      << ", stats: " << config.stat_count << "\n";
+  out << "input: " << input_size << " bytes\n";
+  out << "generate: " << times.generate_ms << " ms\n";
+  out << "parse: " << times.parse_ms << " ms\n";
+  out << "build: " << times.build_ms << " ms\n";
+  out << "query: " << times.query_ms << " ms\n";
+  out << "serialize: " << times.serialize_ms << " ms (" << output.str().size() << " bytes)\n";
+  out << "throughput: " << latency.throughput_rps << " req/s\n";
+  out << "latency us: p50 " << latency.p50_us << ", p90 " << latency.p90_us
+      << ", p99 " << latency.p99_us << ", max " << latency.max_us << "\n";
+  out << "metrics: " << tb.GetMetrics().ToJson().ToString() << "\n";
+}
+} // namespace bench
+
+//------------------------mapped_catalogue.hpp--------------------------------
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mapped {
+/**
+ * @brief Packs base requests into file read by MappedCatalogue.
+ * Stops are ordered by Morton code of their coordinates, so stops close
+ * on the map are close in the file, bus routes are stored one after another.
+ */
+void PackCatalogue(std::vector<Request> const & base_requests, std::string const & path);
+
+/**
+ * @brief Checks whether file starts with packed catalogue signature
+ */
+bool IsPackedCatalogue(std::string const & path);
+
+/**
+ * @brief Read-only catalogue over memory-mapped packed file, answers
+ * stat requests the same way as TransportBase. Only name indexes are
+ * kept resident, routes, points and distances are paged by OS on demand.
+ */
+class MappedCatalogue : public StatCatalogue {
+public:
+  explicit MappedCatalogue(std::string const & path);
+  ~MappedCatalogue() override;
+
+  MappedCatalogue(MappedCatalogue const &) = delete;
+  MappedCatalogue & operator=(MappedCatalogue const &) = delete;
+
+  Response AnswerStatRequest(Request const & request, metrics::Metrics & metrics) const override;
+
+  TransportBase::BusStat CalculateStatForBus(std::string_view bus_name, metrics::Counters & counters) const;
+  TransportBase::StopStat CalculateStatForStop(std::string_view stop_name, metrics::Counters & counters) const;
+private:
+  template <typename T>
+  struct Span {
+    T const * data = nullptr;
+    size_t size = 0;
+
+    T const & operator[](size_t idx) const {
+      return data[idx];
+    }
+  };
+
+  template <typename T>
+  Span<T> GetSection(size_t section_id) const;
+
+  std::string_view GetStopName(uint32_t stop_id) const;
+  std::string_view GetBusName(uint32_t bus_id) const;
+  std::optional<uint32_t> FindStop(std::string_view name, metrics::Counters & counters) const;
+  std::optional<uint32_t> FindBus(std::string_view name, metrics::Counters & counters) const;
+  int32_t GetRoadDistance(uint32_t from, uint32_t to, metrics::Counters & counters) const;
+
+  char const * m_data = nullptr;
+  size_t m_size = 0;
+};
+} // namespace mapped
+
+//------------------------mapped_catalogue.cpp--------------------------------
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mapped {
+namespace {
+constexpr char SIGNATURE[6] = {'T', 'B', 'P', 'A', 'C', 'K'};
+// files of version 1 had "01" in place of version field
+constexpr uint16_t FORMAT_VERSION = 2;
+
+enum Section : size_t {
+  STOP_POINTS,        // PointRecord[stop_count], stop ids are in Morton order
+  STOP_NAME_OFFSETS,  // uint64_t[stop_count + 1]
+  STOP_NAMES,         // char[]
+  STOP_NAME_ORDER,    // uint32_t[stop_count], stop ids sorted by name
+  DIST_OFFSETS,       // uint64_t[stop_count + 1]
+  DIST_ENTRIES,       // DistanceRecord[], sorted by to_stop within stop
+  STOP_BUS_OFFSETS,   // uint64_t[stop_count + 1]
+  STOP_BUS_IDS,       // uint32_t[]
+  BUS_NAME_OFFSETS,   // uint64_t[bus_count + 1], bus ids are in name order
+  BUS_NAMES,          // char[]
+  BUS_ROUTES,         // RouteRecord[bus_count]
+  ROUTE_STOPS,        // uint32_t[], base stops of routes in bus id order
+  SECTION_COUNT,
+};
+
+struct SectionRecord {
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct FileHeader {
+  char signature[6];
+  uint16_t version;
+  SectionRecord sections[SECTION_COUNT];
+};
+
+struct PointRecord {
+  double lat;
+  double lon;
+};
+
+struct DistanceRecord {
+  uint32_t to_stop;
+  int32_t dist;
+};
+
+struct RouteRecord {
+  uint64_t offset;
+  uint32_t size;
+  uint32_t is_roundtrip;
+};
+
+struct ElementLayout {
+  size_t size;
+  size_t alignment;
+};
+
+template <typename T>
+constexpr ElementLayout LayoutOf() {
+  return {sizeof(T), alignof(T)};
+}
+
+/// element of every section in Section order
+constexpr ElementLayout SECTION_LAYOUTS[SECTION_COUNT] = {
+  LayoutOf<PointRecord>(), LayoutOf<uint64_t>(), LayoutOf<char>(), LayoutOf<uint32_t>(),
+  LayoutOf<uint64_t>(), LayoutOf<DistanceRecord>(), LayoutOf<uint64_t>(), LayoutOf<uint32_t>(),
+  LayoutOf<uint64_t>(), LayoutOf<char>(), LayoutOf<RouteRecord>(), LayoutOf<uint32_t>(),
+};
+
+/**
+ * @brief Describes first mismatch of header and file, empty for consistent file.
+ * Sections must lie in the file, offset arrays and routes must be ordered
+ * ranges of their values and every stored id must name existing stop or bus,
+ * so no lookup reads outside of the mapping. Names, points and distances
+ * are trusted as written by PackCatalogue
+ */
+std::string FindLayoutError(char const * data, size_t size) {
+  if (size < sizeof(FileHeader)) {
+    return "file is shorter than header";
+  }
+  auto const & header = *reinterpret_cast<FileHeader const *>(data);
+  if (std::memcmp(header.signature, SIGNATURE, sizeof(SIGNATURE)) != 0) {
+    return "no signature";
+  }
+  if (header.version != FORMAT_VERSION) {
+    return "unsupported version " + std::to_string(header.version);
+  }
+  for (size_t section = 0; section < SECTION_COUNT; section++) {
+    SectionRecord const & record = header.sections[section];
+    ElementLayout const & layout = SECTION_LAYOUTS[section];
+    if (record.offset > size || record.offset % layout.alignment != 0
+        || record.size > (size - record.offset) / layout.size) {
+      return "section " + std::to_string(section) + " is out of file";
+    }
+  }
+
+  auto count = [&header](Section section) {
+    return header.sections[section].size;
+  };
+  uint64_t const stop_count = count(STOP_POINTS);
+  uint64_t const bus_count = count(BUS_ROUTES);
+  if (count(STOP_NAME_ORDER) != stop_count) {
+    return "stop name order doesn't match stops";
+  }
+  struct OffsetsOf {
+    Section offsets;
+    uint64_t owner_count;
+    Section values;
+  };
+  for (OffsetsOf const & check : {OffsetsOf{STOP_NAME_OFFSETS, stop_count, STOP_NAMES},
+                                  OffsetsOf{DIST_OFFSETS, stop_count, DIST_ENTRIES},
+                                  OffsetsOf{STOP_BUS_OFFSETS, stop_count, STOP_BUS_IDS},
+                                  OffsetsOf{BUS_NAME_OFFSETS, bus_count, BUS_NAMES}}) {
+    auto offsets = reinterpret_cast<uint64_t const *>(data + header.sections[check.offsets].offset);
+    if (count(check.offsets) != check.owner_count + 1 || offsets[0] != 0
+        || offsets[check.owner_count] != count(check.values)
+        || !std::is_sorted(offsets, offsets + check.owner_count + 1)) {
+      return "section " + std::to_string(check.offsets) + " doesn't match its values";
+    }
+  }
+
+  auto section_data = [data, &header](Section section) {
+    return data + header.sections[section].offset;
+  };
+  struct IdsOf {
+    Section ids;
+    uint64_t limit;
+  };
+  for (IdsOf const & check : {IdsOf{STOP_NAME_ORDER, stop_count},
+                              IdsOf{STOP_BUS_IDS, bus_count},
+                              IdsOf{ROUTE_STOPS, stop_count}}) {
+    auto ids = reinterpret_cast<uint32_t const *>(section_data(check.ids));
+    if (std::any_of(ids, ids + count(check.ids), [limit = check.limit](uint32_t id) { return id >= limit; })) {
+      return "section " + std::to_string(check.ids) + " has unknown id";
+    }
+  }
+  auto entries = reinterpret_cast<DistanceRecord const *>(section_data(DIST_ENTRIES));
+  if (std::any_of(entries, entries + count(DIST_ENTRIES),
+                  [stop_count](DistanceRecord const & entry) { return entry.to_stop >= stop_count; })) {
+    return "section " + std::to_string(DIST_ENTRIES) + " has unknown id";
+  }
+
+  // routes are stored one after another in bus id order
+  auto routes = reinterpret_cast<RouteRecord const *>(section_data(BUS_ROUTES));
+  uint64_t route_end = 0;
+  for (uint64_t bus_id = 0; bus_id < bus_count; bus_id++) {
+    RouteRecord const & route = routes[bus_id];
+    if (route.offset < route_end || route.offset > count(ROUTE_STOPS)
+        || route.size > count(ROUTE_STOPS) - route.offset) {
+      return "route of bus " + std::to_string(bus_id) + " is out of route stops";
+    }
+    route_end = route.offset + route.size;
+  }
+  return {};
+}
+
+constexpr size_t PAGE_ALIGNMENT = 4096;
+
+uint64_t MortonCode(double lat, double lon) {
+  auto quantize = [](double value, double min, double max) -> uint64_t {
+    double norm = std::clamp((value - min) / (max - min), 0.0, 1.0);
+    return static_cast<uint64_t>(norm * 0xFFFFFFFFu);
+  };
+  auto spread = [](uint64_t x) {
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+  };
+  return spread(quantize(lat, -90.0, 90.0)) | (spread(quantize(lon, -180.0, 180.0)) << 1);
+}
+
+class SectionWriter {
+public:
+  explicit SectionWriter(std::ofstream & out) : m_out(out) {
+    m_out.write(reinterpret_cast<char const *>(&m_header), sizeof(m_header));
+    m_pos = sizeof(m_header);
+  }
+
+  template <typename T>
+  void Write(Section section, std::vector<T> const & values) {
+    uint64_t aligned = (m_pos + PAGE_ALIGNMENT - 1) / PAGE_ALIGNMENT * PAGE_ALIGNMENT;
+    std::string padding(aligned - m_pos, '\0');
+    m_out.write(padding.data(), padding.size());
+    m_out.write(reinterpret_cast<char const *>(values.data()), values.size() * sizeof(T));
+    m_header.sections[section] = {aligned, values.size()};
+    m_pos = aligned + values.size() * sizeof(T);
+  }
+
+  void Finish() {
+    std::memcpy(m_header.signature, SIGNATURE, sizeof(SIGNATURE));
+    m_header.version = FORMAT_VERSION;
+    m_out.seekp(0);
+    m_out.write(reinterpret_cast<char const *>(&m_header), sizeof(m_header));
+  }
+private:
+  std::ofstream & m_out;
+  FileHeader m_header{};
+  uint64_t m_pos = 0;
+};
+
+void AppendName(std::string_view name, std::vector<char> & names, std::vector<uint64_t> & offsets) {
+  names.insert(names.end(), name.begin(), name.end());
+  offsets.push_back(names.size());
+}
+
+static const std::string PACK_NAME = "name";
+static const std::string PACK_TYPE = "type";
+static const std::string PACK_BUS = "Bus";
+static const std::string PACK_STOPS = "stops";
+static const std::string PACK_IS_ROUNDTRIP = "is_roundtrip";
+static const std::string PACK_LATITUDE = "latitude";
+static const std::string PACK_LONGITUDE = "longitude";
+static const std::string PACK_ROAD_DISTANCES = "road_distances";
+static const std::string PACK_BUS_STAT_METRIC = "bus_stat";
+static const std::string PACK_STOP_STAT_METRIC = "stop_stat";
+} // namespace
+
+void PackCatalogue(std::vector<Request> const & base_requests, std::string const & path) {
+  // the later request wins the same way as in TransportBase
+  std::map<std::string_view, Json::Map const *> stop_bodies;
+  std::map<std::string_view, Json::Map const *> bus_bodies;
+  for (Request const & request : base_requests) {
+    if (request.GetType() != Request::Type::BASE) {
+      continue;
+    }
+    Json::Map const & body = request.GetRequestBody().AsMap();
+    std::string_view name = body.at(PACK_NAME).AsString();
+    if (body.at(PACK_TYPE).AsString() == PACK_BUS) {
+      bus_bodies[name] = &body;
+    } else {
+      stop_bodies[name] = &body;
+    }
+  }
+
+  size_t const stop_count = stop_bodies.size();
+  std::vector<std::string_view> names_by_order;
+  std::vector<PointRecord> points_by_order;
+  for (auto const & [name, body] : stop_bodies) {
+    names_by_order.push_back(name);
+    points_by_order.push_back({body->at(PACK_LATITUDE).AsDouble(), body->at(PACK_LONGITUDE).AsDouble()});
+  }
+
+  // stop id is position in Morton order, name order is position in stop_bodies,
+  // morton_order[id] is name order of the stop
+  std::vector<uint32_t> morton_order(stop_count);
+  std::iota(morton_order.begin(), morton_order.end(), 0);
+  std::stable_sort(morton_order.begin(), morton_order.end(), [&](uint32_t lhs, uint32_t rhs) {
+    return MortonCode(points_by_order[lhs].lat, points_by_order[lhs].lon)
+           < MortonCode(points_by_order[rhs].lat, points_by_order[rhs].lon);
+  });
+  std::vector<uint32_t> id_by_name_order(stop_count);
+  for (uint32_t id = 0; id < stop_count; id++) {
+    id_by_name_order[morton_order[id]] = id;
+  }
+  std::unordered_map<std::string_view, uint32_t> stop_ids;
+  for (uint32_t i = 0; i < stop_count; i++) {
+    stop_ids[names_by_order[i]] = id_by_name_order[i];
+  }
+
+  std::vector<PointRecord> points(stop_count);
+  std::vector<char> stop_names;
+  std::vector<uint64_t> stop_name_offsets = {0};
+  std::vector<uint64_t> dist_offsets = {0};
+  std::vector<DistanceRecord> dist_entries;
+  for (uint32_t id = 0; id < stop_count; id++) {
+    uint32_t idx = morton_order[id];
+    points[id] = points_by_order[idx];
+    AppendName(names_by_order[idx], stop_names, stop_name_offsets);
+
+    Json::Map const & body = *stop_bodies[names_by_order[idx]];
+    size_t first = dist_entries.size();
+    if (auto it = body.find(PACK_ROAD_DISTANCES); it != body.end()) {
+      for (auto const & [to_name, dist] : it->second.AsMap()) {
+        if (auto to_it = stop_ids.find(to_name); to_it != stop_ids.end()) {
+          dist_entries.push_back({to_it->second, dist.AsInt()});
+        }
+      }
+    }
+    std::sort(dist_entries.begin() + first, dist_entries.end(), [](auto const & lhs, auto const & rhs) {
+      return lhs.to_stop < rhs.to_stop;
+    });
+    dist_offsets.push_back(dist_entries.size());
+  }
+  std::vector<uint32_t> stop_name_order(id_by_name_order.begin(), id_by_name_order.end());
+
+  std::vector<char> bus_names;
+  std::vector<uint64_t> bus_name_offsets = {0};
+  std::vector<RouteRecord> routes;
+  std::vector<uint32_t> route_stops;
+  std::vector<std::vector<uint32_t>> buses_of_stop(stop_count);
+  for (auto const & [name, body] : bus_bodies) {
+    uint32_t bus_id = routes.size();
+    AppendName(name, bus_names, bus_name_offsets);
+
+    RouteRecord route{route_stops.size(), 0, 1};
+    if (auto it = body->find(PACK_STOPS); it != body->end()) {
+      for (Json::Node const & stop : it->second.AsArray()) {
+        uint32_t stop_id = stop_ids.at(stop.AsString());
+        route_stops.push_back(stop_id);
+        if (buses_of_stop[stop_id].empty() || buses_of_stop[stop_id].back() != bus_id) {
+          buses_of_stop[stop_id].push_back(bus_id);
+        }
+      }
+      route.size = route_stops.size() - route.offset;
+      route.is_roundtrip = body->at(PACK_IS_ROUNDTRIP).AsBool();
+    }
+    routes.push_back(route);
+  }
+
+  std::vector<uint64_t> stop_bus_offsets = {0};
+  std::vector<uint32_t> stop_bus_ids;
+  for (auto & bus_ids : buses_of_stop) {
+    std::sort(bus_ids.begin(), bus_ids.end());
+    bus_ids.erase(std::unique(bus_ids.begin(), bus_ids.end()), bus_ids.end());
+    stop_bus_ids.insert(stop_bus_ids.end(), bus_ids.begin(), bus_ids.end());
+    stop_bus_offsets.push_back(stop_bus_ids.size());
+  }
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("can't write " + path);
+  }
+  SectionWriter writer(out);
+  writer.Write(STOP_POINTS, points);
+  writer.Write(STOP_NAME_OFFSETS, stop_name_offsets);
+  writer.Write(STOP_NAMES, stop_names);
+  writer.Write(STOP_NAME_ORDER, stop_name_order);
+  writer.Write(DIST_OFFSETS, dist_offsets);
+  writer.Write(DIST_ENTRIES, dist_entries);
+  writer.Write(STOP_BUS_OFFSETS, stop_bus_offsets);
+  writer.Write(STOP_BUS_IDS, stop_bus_ids);
+  writer.Write(BUS_NAME_OFFSETS, bus_name_offsets);
+  writer.Write(BUS_NAMES, bus_names);
+  writer.Write(BUS_ROUTES, routes);
+  writer.Write(ROUTE_STOPS, route_stops);
+  writer.Finish();
+}
+
+bool IsPackedCatalogue(std::string const & path) {
+  std::ifstream input(path, std::ios::binary);
+  char signature[sizeof(SIGNATURE)] = {};
+  input.read(signature, sizeof(signature));
+  return input && std::memcmp(signature, SIGNATURE, sizeof(SIGNATURE)) == 0;
+}
+
+MappedCatalogue::MappedCatalogue(std::string const & path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("can't open " + path);
+  }
+  struct stat st{};
+  if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+    close(fd);
+    throw std::runtime_error("bad packed catalogue " + path + ": file is shorter than header");
+  }
+  m_size = st.st_size;
+  void * data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("can't map " + path);
+  }
+  m_data = static_cast<char const *>(data);
+
+  if (std::string error = FindLayoutError(m_data, m_size); !error.empty()) {
+    munmap(const_cast<char *>(m_data), m_size);
+    throw std::runtime_error("bad packed catalogue " + path + ": " + error);
+  }
+  auto const & header = *reinterpret_cast<FileHeader const *>(m_data);
+
+  // name indexes are touched by every request, the rest is read on demand
+  madvise(const_cast<char *>(m_data), m_size, MADV_RANDOM);
+  for (Section section : {STOP_NAME_OFFSETS, STOP_NAMES, STOP_NAME_ORDER, BUS_NAME_OFFSETS, BUS_NAMES}) {
+    SectionRecord const & record = header.sections[section];
+    madvise(const_cast<char *>(m_data) + record.offset, record.size, MADV_WILLNEED);
+  }
+}
+
+MappedCatalogue::~MappedCatalogue() {
+  munmap(const_cast<char *>(m_data), m_size);
+}
+
+template <typename T>
+MappedCatalogue::Span<T> MappedCatalogue::GetSection(size_t section_id) const {
+  auto const & record = reinterpret_cast<FileHeader const *>(m_data)->sections[section_id];
+  return {reinterpret_cast<T const *>(m_data + record.offset), record.size};
+}
+
+std::string_view MappedCatalogue::GetStopName(uint32_t stop_id) const {
+  auto offsets = GetSection<uint64_t>(STOP_NAME_OFFSETS);
+  auto names = GetSection<char>(STOP_NAMES);
+  return {names.data + offsets[stop_id], offsets[stop_id + 1] - offsets[stop_id]};
+}
+
+std::string_view MappedCatalogue::GetBusName(uint32_t bus_id) const {
+  auto offsets = GetSection<uint64_t>(BUS_NAME_OFFSETS);
+  auto names = GetSection<char>(BUS_NAMES);
+  return {names.data + offsets[bus_id], offsets[bus_id + 1] - offsets[bus_id]};
+}
+
+std::optional<uint32_t> MappedCatalogue::FindStop(std::string_view name, metrics::Counters & counters) const {
+  ++counters.map_lookups;
+  auto order = GetSection<uint32_t>(STOP_NAME_ORDER);
+  auto it = std::lower_bound(order.data, order.data + order.size, name, [this](uint32_t id, std::string_view value) {
+    return GetStopName(id) < value;
+  });
+  if (it != order.data + order.size && GetStopName(*it) == name) {
+    return *it;
+  }
+  return std::nullopt;
+}
+
+std::optional<uint32_t> MappedCatalogue::FindBus(std::string_view name, metrics::Counters & counters) const {
+  ++counters.map_lookups;
+  size_t lo = 0;
+  size_t hi = GetSection<RouteRecord>(BUS_ROUTES).size;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (GetBusName(mid) < name) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo < GetSection<RouteRecord>(BUS_ROUTES).size && GetBusName(lo) == name) {
+    return lo;
+  }
+  return std::nullopt;
+}
+
+int32_t MappedCatalogue::GetRoadDistance(uint32_t from, uint32_t to, metrics::Counters & counters) const {
+  auto offsets = GetSection<uint64_t>(DIST_OFFSETS);
+  auto entries = GetSection<DistanceRecord>(DIST_ENTRIES);
+  auto find = [&](uint32_t stop, uint32_t other) -> int32_t {
+    ++counters.map_lookups;
+    DistanceRecord const * first = entries.data + offsets[stop];
+    DistanceRecord const * last = entries.data + offsets[stop + 1];
+    auto it = std::lower_bound(first, last, other, [](DistanceRecord const & record, uint32_t value) {
+      return record.to_stop < value;
+    });
+    return it != last && it->to_stop == other ? it->dist : -1;
+  };
+
+  int32_t dist = find(from, to);
+  if (dist == -1) {
+    ++counters.distance_misses;
+    return find(to, from);
+  }
+  return dist;
+}
+
+Response MappedCatalogue::AnswerStatRequest(Request const & request, metrics::Metrics & metrics) const {
+  Json::Map const & body = request.GetRequestBody().AsMap();
+  bool const is_bus = body.at(PACK_TYPE).AsString() == PACK_BUS;
+  metrics::RequestScope scope(metrics, is_bus ? PACK_BUS_STAT_METRIC : PACK_STOP_STAT_METRIC);
+  metrics::Counters & counters = scope.GetCounters();
+  std::string const & name = body.at(PACK_NAME).AsString();
+  if (is_bus) {
+    return Response(CalculateStatForBus(name, counters).ToJson(), request.GetId());
+  }
+  return Response(CalculateStatForStop(name, counters).ToJson(), request.GetId());
+}
+
+TransportBase::BusStat MappedCatalogue::CalculateStatForBus(std::string_view bus_name,
+                                                            metrics::Counters & counters) const {
+  std::optional<uint32_t> bus_id = FindBus(bus_name, counters);
+  if (!bus_id) {
+    return {.bus_name = std::string(bus_name),
+            .is_found = false};
+  }
+
+  RouteRecord const & route = GetSection<RouteRecord>(BUS_ROUTES)[*bus_id];
+  uint32_t const * stops = GetSection<uint32_t>(ROUTE_STOPS).data + route.offset;
+  auto points = GetSection<PointRecord>(STOP_POINTS);
+
+  long double dist_earth = 0.0;
+  int32_t dist_road = 0;
+  for (uint32_t i = 1; i < route.size; i++) {
+    uint32_t prev = stops[i - 1];
+    uint32_t cur = stops[i];
+    ++counters.hops;
+    dist_road += GetRoadDistance(prev, cur, counters);
+    long double hop_earth = geom2d::CalculateDistance(geom2d::PointD(points[prev].lat, points[prev].lon),
+                                                      geom2d::PointD(points[cur].lat, points[cur].lon));
+    dist_earth += hop_earth;
+
+    if (!route.is_roundtrip) {
+      ++counters.hops;
+      dist_road += GetRoadDistance(cur, prev, counters);
+      dist_earth += hop_earth;
+    }
+  }
+
+  std::vector<uint32_t> unique_stops(stops, stops + route.size);
+  std::sort(unique_stops.begin(), unique_stops.end());
+  size_t unique_count = std::unique(unique_stops.begin(), unique_stops.end()) - unique_stops.begin();
+  size_t stops_count = route.is_roundtrip || route.size == 0 ? route.size : route.size * 2 - 1;
+
+  return {.bus_name = std::string(bus_name),
+          .is_found = true,
+          .stops_count = static_cast<int32_t>(stops_count),
+          .unique_stop_count = static_cast<int32_t>(unique_count),
+          .route_length = dist_road,
+          .curvature = geom2d::CalculateCurvature(dist_road, dist_earth)};
+}
+
+TransportBase::StopStat MappedCatalogue::CalculateStatForStop(std::string_view stop_name,
+                                                              metrics::Counters & counters) const {
+  std::optional<uint32_t> stop_id = FindStop(stop_name, counters);
+  if (!stop_id) {
+    return {.stop_name = std::string(stop_name),
+            .is_found = false,
+            .buses = {}};
+  }
+
+  auto offsets = GetSection<uint64_t>(STOP_BUS_OFFSETS);
+  auto bus_ids = GetSection<uint32_t>(STOP_BUS_IDS);
+  std::vector<std::string> buses;
+  buses.reserve(offsets[*stop_id + 1] - offsets[*stop_id]);
+  for (uint64_t i = offsets[*stop_id]; i < offsets[*stop_id + 1]; i++) {
+    buses.emplace_back(GetBusName(bus_ids[i]));
+  }
+  return {.stop_name = std::string(stop_name),
+          .is_found = true,
+          .buses = std::move(buses)};
+}
+} // namespace mapped
+
+//------------------------server.hpp------------------------------------------
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace server {
+/**
+ * @brief Fixed count of workers with bounded task queue,
+ * Submit blocks while queue is full
+ */
+class ThreadPool {
+public:
+  ThreadPool(size_t worker_count, size_t queue_capacity);
+  ~ThreadPool();
+
+  void Submit(std::function<void(size_t worker_idx)> task);
+  size_t WorkerCount() const;
+private:
+  void WorkerLoop(size_t worker_idx);
+
+  size_t m_queue_capacity;
+  std::mutex m_mutex;
+  std::condition_variable m_not_empty;
+  std::condition_variable m_not_full;
+  std::deque<std::function<void(size_t)>> m_tasks;
+  bool m_stopped = false;
+  std::vector<std::thread> m_workers;
+};
+
+struct ServerConfig {
+  size_t worker_count = 4;
+  size_t queue_capacity = 1024;
+  /// responses being computed per connection, reading pauses above it
+  size_t max_in_flight = 1024;
+  /// workers collect metrics reported by CollectMetrics
+  bool collect_metrics = false;
+};
+
+/**
+ * @brief Answers newline-delimited stat requests with newline-delimited
+ * responses in the same order, base must not change while serving
+ */
+class CatalogueServer {
+public:
+  CatalogueServer(StatCatalogue const & base, ServerConfig const & config);
+
+  /**
+   * @brief Serves one stream until eof of in_fd or until out_fd is closed by reader
+   */
+  void ServeStream(int in_fd, int out_fd);
+
+  /**
+   * @brief Accepts connections on unix domain socket until Stop or error,
+   * then waits for open connections to answer requests read so far.
+   * Existing file at socket_path is replaced only when it is a socket
+   */
+  void ServeUnixSocket(std::string const & socket_path);
+
+  /**
+   * @brief Makes ServeUnixSocket stop accepting, safe to call from signal handler
+   */
+  void Stop();
+
+  /**
+   * @brief Metrics of all workers, call after serving returned
+   */
+  metrics::Metrics CollectMetrics() const;
+private:
+  std::string AnswerLine(std::string const & line, size_t worker_idx) const;
+
+  StatCatalogue const & m_base;
+  ServerConfig m_config;
+  mutable std::vector<metrics::Metrics> m_worker_metrics;
+  std::atomic<int> m_listen_fd{-1};
+  ThreadPool m_pool;
+};
+
+/**
+ * @brief SIGINT and SIGTERM stop server instead of killing the process
+ */
+void StopOnSignals(CatalogueServer & server);
+
+/**
+ * @brief Stand-in client: sends lines of in to unix socket, prints answers to out
+ */
+void RunClient(std::string const & socket_path, std::istream & in, std::ostream & out);
+} // namespace server
+
+//------------------------server.cpp------------------------------------------
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <list>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace server {
+namespace {
+/**
+ * @brief Buffered reading of lines from file descriptor
+ */
+class LineReader {
+public:
+  explicit LineReader(int fd) : m_fd(fd) {}
+
+  bool ReadLine(std::string & line) {
+    line.clear();
+    while (true) {
+      if (m_pos == m_size) {
+        ssize_t n = read(m_fd, m_buffer, sizeof(m_buffer));
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          return !line.empty();
+        }
+        m_pos = 0;
+        m_size = static_cast<size_t>(n);
+      }
+      char const * begin = m_buffer + m_pos;
+      char const * end = static_cast<char const *>(std::memchr(begin, '\n', m_size - m_pos));
+      if (end) {
+        line.append(begin, end);
+        m_pos += end - begin + 1;
+        return true;
       }
+      line.append(begin, m_size - m_pos);
+      m_pos = m_size;
+    }
+  }
+private:
+  int m_fd;
+  char m_buffer[1 << 16];
+  size_t m_pos = 0;
+  size_t m_size = 0;
+};
 
-      return Json::Node(std::move(dict));
+bool WriteAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t n = write(fd, data.data(), data.size());
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data.remove_prefix(static_cast<size_t>(n));
+  }
+  return true;
+}
+
+sockaddr_un MakeUnixAddress(std::string const & socket_path) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    throw std::invalid_argument("socket path is too long: " + socket_path);
+  }
+  std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+  return addr;
+}
+
+std::runtime_error SystemError(std::string const & what) {
+  return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+/**
+ * @brief Writes to closed peer fail with EPIPE instead of killing the process
+ */
+void IgnoreSigpipe() {
+  signal(SIGPIPE, SIG_IGN);
+}
+
+/**
+ * @brief Unlinks socket left by previous server, refuses to remove any other file
+ */
+void RemoveStaleSocket(std::string const & socket_path) {
+  struct stat info{};
+  if (lstat(socket_path.c_str(), &info) < 0) {
+    return;
+  }
+  if (!S_ISSOCK(info.st_mode)) {
+    throw std::runtime_error(socket_path + " exists and is not a socket");
+  }
+  unlink(socket_path.c_str());
+}
+
+std::atomic<CatalogueServer *> g_signaled_server{nullptr};
+
+void StopSignaledServer(int) {
+  if (CatalogueServer * server = g_signaled_server.load()) {
+    server->Stop();
+  }
+}
+} // namespace
+
+ThreadPool::ThreadPool(size_t worker_count, size_t queue_capacity)
+        : m_queue_capacity(std::max<size_t>(queue_capacity, 1)) {
+  worker_count = std::max<size_t>(worker_count, 1);
+  for (size_t i = 0; i < worker_count; i++) {
+    m_workers.emplace_back([this, i] { WorkerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = true;
+  }
+  m_not_empty.notify_all();
+  for (auto & worker : m_workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Submit(std::function<void(size_t)> task) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_not_full.wait(lock, [this] { return m_tasks.size() < m_queue_capacity; });
+  m_tasks.push_back(std::move(task));
+  lock.unlock();
+  m_not_empty.notify_one();
+}
+
+size_t ThreadPool::WorkerCount() const {
+  return m_workers.size();
+}
+
+void ThreadPool::WorkerLoop(size_t worker_idx) {
+  while (true) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_not_empty.wait(lock, [this] { return m_stopped || !m_tasks.empty(); });
+    if (m_tasks.empty()) {
+      return;
+    }
+    auto task = std::move(m_tasks.front());
+    m_tasks.pop_front();
+    lock.unlock();
+    m_not_full.notify_one();
+
+    task(worker_idx);
+  }
+}
+
+CatalogueServer::CatalogueServer(StatCatalogue const & base, ServerConfig const & config)
+        : m_base(base),
+          m_config(config),
+          m_worker_metrics(std::max<size_t>(config.worker_count, 1), metrics::Metrics(config.collect_metrics)),
+          m_pool(config.worker_count, config.queue_capacity) {
+  IgnoreSigpipe();
+}
+
+std::string CatalogueServer::AnswerLine(std::string const & line, size_t worker_idx) const {
+  try {
+    Request request(Request::Type::STAT, Json::Load(std::string_view(line)).GetRoot());
+    return m_base.AnswerStatRequest(request, m_worker_metrics[worker_idx])
+            .GetResponseBody().ToString();
+  }
+  catch (std::exception const &) {
+    Json::Map dict;
+    dict[ERROR_MESSAGE] = Json::Node(std::string("bad request"));
+    return Json::Node(std::move(dict)).ToString();
+  }
+}
+
+void CatalogueServer::ServeStream(int in_fd, int out_fd) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::future<std::string>> in_flight;
+  bool is_eof = false;
+  // reader closed out_fd, requests are no longer read
+  bool is_dropped = false;
+
+  // responses are written in order of requests while later ones are computed,
+  // after write error they are only waited for, so workers don't outlive the stream
+  std::thread writer([&] {
+    bool is_ok = true;
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return is_eof || !in_flight.empty(); });
+      if (in_flight.empty()) {
+        return;
+      }
+      std::future<std::string> response = std::move(in_flight.front());
+      in_flight.pop_front();
+      lock.unlock();
+      cv.notify_all();
+
+      std::string text = response.get();
+      text.push_back('\n');
+      if (is_ok && !WriteAll(out_fd, text)) {
+        is_ok = false;
+        lock.lock();
+        is_dropped = true;
+        lock.unlock();
+        cv.notify_all();
+      }
+    }
+  });
+
+  LineReader reader(in_fd);
+  for (std::string line; reader.ReadLine(line); ) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    auto task = std::make_shared<std::packaged_task<std::string(size_t)>>(
+            [this, line = std::move(line)](size_t worker_idx) {
+              return AnswerLine(line, worker_idx);
+            });
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return is_dropped || in_flight.size() < m_config.max_in_flight; });
+      if (is_dropped) {
+        break;
+      }
+      in_flight.push_back(task->get_future());
     }
+    cv.notify_all();
+    m_pool.Submit([task](size_t worker_idx) { (*task)(worker_idx); });
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    is_eof = true;
+  }
+  cv.notify_all();
+  writer.join();
+}
+
+void CatalogueServer::ServeUnixSocket(std::string const & socket_path) {
+  sockaddr_un addr = MakeUnixAddress(socket_path);
+  RemoveStaleSocket(socket_path);
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    throw SystemError("socket");
+  }
+  if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0
+      || listen(listen_fd, SOMAXCONN) < 0) {
+    close(listen_fd);
+    throw SystemError("bind " + socket_path);
+  }
+  m_listen_fd = listen_fd;
+
+  struct Connection {
+    int fd;
+    std::atomic<bool> is_done{false};
+    std::thread thread;
   };
+  // fd is closed only after join, so shutdown never hits a reused descriptor
+  auto join = [](Connection & connection) {
+    connection.thread.join();
+    close(connection.fd);
+  };
+  std::list<Connection> connections;
 
-  std::vector<Response> ConsumeRequests(std::vector<Request> requests);
+  while (true) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    for (auto it = connections.begin(); it != connections.end(); ) {
+      if (it->is_done) {
+        join(*it);
+        it = connections.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    Connection & connection = connections.emplace_back();
+    connection.fd = fd;
+    connection.thread = std::thread([this, &connection] {
+      ServeStream(connection.fd, connection.fd);
+      // client sees eof now, fd itself is closed by join
+      shutdown(connection.fd, SHUT_RDWR);
+      connection.is_done = true;
+    });
+  }
+  m_listen_fd = -1;
+  close(listen_fd);
+  unlink(socket_path.c_str());
 
-  bus_model::BusPtr ParseBus(Request const & request);
-  bus_model::StopPtr ParseStop(Request const & request);
-  std::vector<std::string> ParseStopByDel(std::string_view stops, char del);
+  // connections see eof and finish requests already read
+  for (Connection & connection : connections) {
+    shutdown(connection.fd, SHUT_RD);
+  }
+  for (Connection & connection : connections) {
+    join(connection);
+  }
+}
+
+void CatalogueServer::Stop() {
+  int listen_fd = m_listen_fd;
+  if (listen_fd >= 0) {
+    shutdown(listen_fd, SHUT_RDWR);
+  }
+}
+
+metrics::Metrics CatalogueServer::CollectMetrics() const {
+  metrics::Metrics result;
+  for (auto const & worker_metrics : m_worker_metrics) {
+    result.Merge(worker_metrics);
+  }
+  return result;
+}
+
+void StopOnSignals(CatalogueServer & server) {
+  g_signaled_server = &server;
+  struct sigaction action{};
+  action.sa_handler = StopSignaledServer;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+}
+
+void RunClient(std::string const & socket_path, std::istream & in, std::ostream & out) {
+  IgnoreSigpipe();
+  sockaddr_un addr = MakeUnixAddress(socket_path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    throw SystemError("socket");
+  }
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    close(fd);
+    throw SystemError("connect " + socket_path);
+  }
+
+  // requests are sent without waiting for answers
+  std::thread sender([&in, fd] {
+    for (std::string line; std::getline(in, line); ) {
+      line.push_back('\n');
+      if (!WriteAll(fd, line)) {
+        break;
+      }
+    }
+    shutdown(fd, SHUT_WR);
+  });
+
+  LineReader reader(fd);
+  for (std::string line; reader.ReadLine(line); ) {
+    out << line << '\n';
+  }
+  out.flush();
+  sender.join();
+  close(fd);
+}
+} // namespace server
+
+//------------------------json_test.cpp---------------------------------------
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+
+namespace json_test {
+template <class T>
+std::ostream& operator<<(std::ostream& os, const std::vector<T>& items) {
+  os << "{";
+  for (size_t i = 0; i < items.size(); i++) {
+    os << (i == 0 ? "" : ", ") << items[i];
+  }
+  return os << "}";
+}
+
+template <class K, class V>
+std::ostream& operator<<(std::ostream& os, const std::map<K, V>& items) {
+  os << "{";
+  bool is_first = true;
+  for (const auto& [key, value] : items) {
+    os << (is_first ? "" : ", ") << key << ": " << value;
+    is_first = false;
+  }
+  return os << "}";
+}
+
+template <class T, class U>
+void AssertEqual(const T& t, const U& u, const std::string& hint = {}) {
+  if (!(t == u)) {
+    std::ostringstream os;
+    os << "Assertion failed: " << t << " != " << u;
+    if (!hint.empty()) {
+      os << " hint: " << hint;
+    }
+    throw std::runtime_error(os.str());
+  }
+}
+
+void Assert(bool b, const std::string& hint) {
+  AssertEqual(b, true, hint);
+}
+
+/** @brief Glob with * for any sequence and ? for any character */
+bool MatchesGlob(std::string_view pattern, std::string_view name) {
+  if (pattern.empty()) {
+    return name.empty();
+  }
+  if (pattern[0] == '*') {
+    for (size_t skip = 0; skip <= name.size(); skip++) {
+      if (MatchesGlob(pattern.substr(1), name.substr(skip))) {
+        return true;
+      }
+    }
+    return false;
+  }
+  return !name.empty() && (pattern[0] == '?' || pattern[0] == name[0]) &&
+         MatchesGlob(pattern.substr(1), name.substr(1));
+}
+
+/**
+ * @brief Runs registered tests one by one, src.cpp is built alone,
+ * so it keeps own small runner instead of TestFrameWorkAndProfiler/test_runner.h
+ */
+class TestRunner {
+public:
+  void RunTest(std::function<void()> func, std::string name) {
+    tests_.push_back({std::move(name), std::move(func)});
+  }
+
+  /**
+   * @brief Runs tests matching any of comma separated globs of --filter=,
+   * prints --slowest=N tests after the run
+   * @return 0 when every selected test passed and 1 otherwise
+   */
+  int Run(int argc, char * argv[]) {
+    std::vector<std::string> filters;
+    size_t slowest = 0;
+    for (int i = 1; i < argc; i++) {
+      std::string_view arg = argv[i];
+      if (arg.rfind("--filter=", 0) == 0) {
+        std::istringstream globs(std::string(arg.substr(9)));
+        for (std::string glob; std::getline(globs, glob, ','); ) {
+          if (!glob.empty()) {
+            filters.push_back(glob);
+          }
+        }
+      } else if (arg.rfind("--slowest=", 0) == 0) {
+        slowest = std::max(0, std::atoi(argv[i] + 10));
+      }
+    }
+
+    std::vector<std::pair<double, std::string>> times;
+    size_t fail_count = 0;
+    for (const auto& [name, func] : tests_) {
+      bool is_selected = filters.empty() || std::any_of(filters.begin(), filters.end(),
+          [&name = name](const std::string& filter) { return MatchesGlob(filter, name); });
+      if (!is_selected) {
+        continue;
+      }
+      auto start = std::chrono::steady_clock::now();
+      std::string message;
+      try {
+        func();
+      } catch (std::exception& e) {
+        message = e.what();
+      } catch (...) {
+        message = "Unknown exception caught";
+      }
+      double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      times.emplace_back(ms, name);
+      fail_count += !message.empty();
+      std::cerr << name << (message.empty() ? " OK" : " fail: " + message) << " (" << ms << " ms)" << std::endl;
+    }
+
+    slowest = std::min(slowest, times.size());
+    if (slowest > 0) {
+      std::partial_sort(times.begin(), times.begin() + slowest, times.end(), std::greater<>());
+      std::cerr << "Slowest tests:" << std::endl;
+      for (size_t i = 0; i < slowest; i++) {
+        std::cerr << "  " << times[i].second << " " << times[i].first << " ms" << std::endl;
+      }
+    }
+    if (fail_count > 0) {
+      std::cerr << fail_count << " unit tests failed" << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+private:
+  std::vector<std::pair<std::string, std::function<void()>>> tests_;
+};
+
+#define ASSERT_EQUAL(x, y) {                                              \
+  std::ostringstream os;                                                  \
+  os << #x << " != " << #y << ", " << __FILE__ << ":" << __LINE__;        \
+  AssertEqual(x, y, os.str());                                            \
+}
+
+#define ASSERT(x) {                                                       \
+  std::ostringstream os;                                                  \
+  os << #x << " is false, " << __FILE__ << ":" << __LINE__;               \
+  Assert(x, os.str());                                                    \
+}
+
+#define RUN_TEST(tr, func) tr.RunTest(func, #func)
+
+/**
+ * @brief Straightforward char by char structural positions,
+ * backslash escapes next char even outside of strings as in scanner
+ */
+std::vector<uint32_t> NaiveStructurals(std::string_view input) {
+  std::vector<uint32_t> positions;
+  bool is_in_string = false;
+  bool is_escaped = false;
+  bool is_in_scalar = false;
+  for (uint32_t i = 0; i < input.size(); i++) {
+    char c = input[i];
+    bool is_quote = c == '"' && !is_escaped;
+    is_escaped = c == '\\' && !is_escaped;
+
+    if (is_in_string) {
+      if (is_quote) {
+        positions.push_back(i);
+        is_in_string = false;
+      }
+      continue;
+    }
+
+    bool is_op = std::string_view("{}[]:,").find(c) != std::string_view::npos;
+    bool is_space = std::string_view(" \t\n\r").find(c) != std::string_view::npos;
+    if (is_quote) {
+      positions.push_back(i);
+      is_in_string = true;
+    } else if (is_op || (!is_space && !is_in_scalar)) {
+      positions.push_back(i);
+    }
+    is_in_scalar = !is_op && !is_space && !is_quote;
+  }
+  return positions;
+}
 
-private:
-  /**
-   * @brief Add Bus with route
-   */
-  void AddBus(bus_model::BusPtr bus);
+/**
+ * @brief Compares nodes, doubles are compared with relative tolerance
+ * as LoadFromStream accumulates rounding errors
+ */
+void AssertNodesEqual(Json::Node const & lhs, Json::Node const & rhs, std::string const & path = "root") {
+  if (lhs.IsType<Json::Array>()) {
+    Assert(rhs.IsType<Json::Array>(), path + " is array");
+    AssertEqual(lhs.AsArray().size(), rhs.AsArray().size(), path + " size");
+    for (size_t i = 0; i < lhs.AsArray().size(); i++) {
+      AssertNodesEqual(lhs.AsArray()[i], rhs.AsArray()[i], path + "[" + std::to_string(i) + "]");
+    }
+  } else if (lhs.IsType<Json::Map>()) {
+    Assert(rhs.IsType<Json::Map>(), path + " is map");
+    AssertEqual(lhs.AsMap().size(), rhs.AsMap().size(), path + " size");
+    for (auto const & [key, value] : lhs.AsMap()) {
+      auto it = rhs.AsMap().find(key);
+      Assert(it != rhs.AsMap().end(), path + " has " + key);
+      AssertNodesEqual(value, it->second, path + "." + key);
+    }
+  } else if (lhs.IsType<double>()) {
+    Assert(rhs.IsType<double>(), path + " is double");
+    Assert(std::abs(lhs.AsDouble() - rhs.AsDouble()) <= 1e-12 * std::abs(lhs.AsDouble()), path + " value");
+  } else {
+    AssertEqual(lhs.ToString(), rhs.ToString(), path);
+  }
+}
 
-  /**
-   * @brief Add Stop with point
-   */
-  void AddStop(bus_model::StopPtr stop);
+void TestPrintDoubles() {
+  std::mt19937_64 rng(5);
+  std::uniform_real_distribution<double> curvature(0.5, 3.0);
+  Json::PrintOptions shortest;
+  shortest.precision = 0;
+  for (int i = 0; i < 10000; i++) {
+    double value = std::ldexp(curvature(rng), static_cast<int>(rng() % 80) - 40);
+    std::ostringstream stream;
+    stream << std::setprecision(7) << value;
+    ASSERT_EQUAL(Json::Node(value).ToString(), stream.str());
+
+    std::string text = Json::Node(value).ToString(shortest);
+    ASSERT_EQUAL(Json::ParseNumber(text)->AsDouble(), value);
+  }
+  ASSERT_EQUAL(Json::Node(2.3036040000000001).ToString(shortest), "2.303604");
+  ASSERT_EQUAL(Json::Node(1e21).ToString(), "1e+21");
+  ASSERT_EQUAL(Json::Node(-0.25).ToString(), "-0.25");
+  ASSERT_EQUAL(Json::Node(INT32_MIN).ToString(), "-2147483648");
+
+  Json::PrintOptions too_precise;
+  too_precise.precision = 30;
+  ASSERT_EQUAL(Json::Node(-1.7976931348623157e308).ToString(too_precise), "-1.7976931348623157e+308");
+  ASSERT_EQUAL(Json::Node(0.1).ToString(too_precise), "0.10000000000000001");
+  for (double value : {INFINITY, -INFINITY, NAN}) {
+    ASSERT_EQUAL(Json::Node(Json::Array{Json::Node(value)}).ToString(), "[null]");
+  }
 
-  BusStat CalculateStatForBus(std::string_view bus_name) const;
-  StopStat CalculateStatForStop(std::string_view stop_name) const;
+  std::string buffer = "prefix ";
+  Json::Node(Json::Array{Json::Node(1.0 / 3), Json::Node(false)}).PrintTo(buffer);
+  ASSERT_EQUAL(buffer, "prefix [0.3333333, false]");
+}
 
-  /**
-   * @brief adds bus_name in all stop objects related with bus
-   *
-   */
-  void UpdateStops(std::string_view bus_name);
+void TestStringEscapes() {
+  ASSERT_EQUAL(Json::DecodeString("plain"), "plain");
+  ASSERT_EQUAL(Json::DecodeString(R"(a\"b\\c\/d\n)"), "a\"b\\c/d\n");
+  ASSERT_EQUAL(Json::DecodeString(R"(\u0041\u00e9\u4E2D\ud83d\ude8c)"), "A\xc3\xa9\xe4\xb8\xad\xf0\x9f\x9a\x8c");
+  for (std::string_view bad : {R"(\x)", R"(\u12)", R"(\u12g4)", R"(\ud83d)", R"(\ud83dx)", R"(\ude8c)", "end\\"}) {
+    try {
+      Json::DecodeString(bad);
+      Assert(false, "DecodeString should throw Json::ParseError for " + std::string(bad));
+    }
+    catch (Json::ParseError &) {
+    }
+  }
 
-private:
-  std::unordered_map<std::string_view, bus_model::BusPtr> m_buses;
-  std::unordered_map<std::string_view, bus_model::StopPtr> m_stops;
+  std::string escaped;
+  Json::EscapeString("Say \"hi\"\t\x01 \xd0\x90", escaped);
+  ASSERT_EQUAL(escaped, R"(Say \"hi\"\t\u0001 )" "\xd0\x90");
 
-  std::unordered_map<std::string_view, std::set<std::string_view>> m_stop_name_and_bus_names;
-};
+  std::mt19937 rng(3);
+  for (int i = 0; i < 2000; i++) {
+    std::string text(rng() % 70, ' ');
+    for (char & c : text) {
+      // mostly plain text so that escapes land at every offset of a 16 byte block
+      c = rng() % 8 == 0 ? static_cast<char>(rng() % 256) : static_cast<char>('a' + rng() % 26);
+    }
+    std::string printed = Json::Node(Json::Map{{text, Json::Node(text)}}).ToString();
+    Json::Document document = Json::Load(std::string_view(printed));
+    ASSERT_EQUAL(document.GetRoot().AsMap().begin()->first, text);
+    ASSERT_EQUAL(document.GetRoot().AsMap().begin()->second.AsString(), text);
+  }
+}
 
-//------------------------transport_base.cpp---------------------------------
-#include <algorithm>
-#include <unordered_set>
+void TestStructuralsOfEscapedQuotes() {
+  std::string_view input = R"({"a\"b": [1, true], "c\\": "x"})";
+  std::vector<uint32_t> positions;
+  Json::StructuralScanner::FindStructurals(input, positions);
 
-namespace {
-static const std::string ID = "id";
-static const std::string TYPE = "type";
-static const std::string BUS_STR = "Bus";
-static const std::string BASE_REQUESTS = "base_requests";
-static const std::string STAT_REQUESTS = "stat_requests";
-static const std::string NAME = "name";
-static const std::string STOPS = "stops";
-static const std::string IS_ROUNDTRIP = "is_roundtrip";
-static const std::string ROAD_DISTANCES = "road_distances";
-static const std::string LONGITUDE = "longitude";
-static const std::string LATITUDE = "latitude";
+  std::string found;
+  for (uint32_t pos : positions) {
+    found += input[pos];
+  }
+  ASSERT_EQUAL(found, R"({"":[1,t],"":""})");
 }
 
-Request::Request(Type const & type, Json::Node json)
-        : m_type(type), m_json(json) {}
+void TestStructuralsMatchNaive() {
+  std::mt19937 rng(7);
+  std::string const alphabet = "{}[]:,\"\\ \t\nab1-.";
+  for (int iteration = 0; iteration < 500; iteration++) {
+    std::string input(rng() % 300, ' ');
+    for (char & c : input) {
+      c = alphabet[rng() % alphabet.size()];
+    }
 
-Request::Type Request::GetType() const {
-  return m_type;
+    std::vector<uint32_t> simd;
+    std::vector<uint32_t> scalar;
+    Json::StructuralScanner::FindStructurals(input, simd);
+    Json::StructuralScanner::FindStructuralsScalar(input, scalar);
+    ASSERT_EQUAL(simd, scalar);
+    ASSERT_EQUAL(scalar, NaiveStructurals(input));
+  }
 }
 
-int32_t Request::GetId() const {
-  return m_json.AsMap().at(ID).AsInt();
+void TestLoadMatchesStreamLoader() {
+  std::vector<std::string> inputs = {
+    R"({"a": [1, -2, 3.5, -0.25, true, false, "str"], "b": {}, "c": [], "d": {"e": [[1], [2, {"f": "g"}]]}})",
+    "  [ 1 ,2,\n\t3 ]  ",
+    R"("single string")",
+    R"({"esc\"aped": ["a\\b", "\"q\"", "\u0410\ud83d\ude8c", "\/\b\f\n\r\t"]})",
+    "42",
+  };
+  bench::NetworkConfig config;
+  config.stop_count = 50;
+  config.bus_count = 10;
+  config.stat_count = 50;
+  std::ostringstream network;
+  bench::GenerateNetworkJson(config, network);
+  inputs.push_back(network.str());
+
+  for (std::string const & input : inputs) {
+    std::istringstream stream_input(input);
+    std::istringstream indexed_input(input);
+    AssertNodesEqual(Json::Load(indexed_input).GetRoot(), Json::LoadFromStream(stream_input).GetRoot());
+  }
 }
 
-Json::Node const & Request::GetRequestBody() const {
-  return m_json;
+void TestGeneratedRoutesHaveNoRepeatedStops() {
+  bench::NetworkConfig config;
+  config.stop_count = 3;
+  config.bus_count = 200;
+  config.route_length = 4;
+  config.overlap = 0.9;
+  config.stat_count = 0;
+  std::stringstream network;
+  bench::GenerateNetworkJson(config, network);
+
+  Json::Document document = Json::Load(network);
+  for (Json::Node const & request : document.GetRoot().AsMap().at("base_requests").AsArray()) {
+    if (request.AsMap().at("type").AsString() != "Bus") {
+      continue;
+    }
+    Json::Array const & stops = request.AsMap().at("stops").AsArray();
+    for (size_t i = 1; i < stops.size(); i++) {
+      ASSERT(stops[i - 1].AsString() != stops[i].AsString());
+    }
+    if (request.AsMap().at("is_roundtrip").AsBool()) {
+      ASSERT_EQUAL(stops.front().AsString(), stops.back().AsString());
+    }
+  }
 }
 
-Response::Response(Json::Node json, int32_t request_id)
-        : m_json(std::move(json)) {
-  m_json.AddValue(Json::Node(request_id), REQUEST_ID);
+void TestMetricsOnlyWhenEnabled() {
+  bench::NetworkConfig config;
+  config.stop_count = 20;
+  config.bus_count = 5;
+  config.stat_count = 20;
+  std::stringstream network;
+  bench::GenerateNetworkJson(config, network);
+  std::vector<Request> requests = ParseRequestsJson(network);
+
+  TransportBase disabled;
+  disabled.ConsumeRequests(requests);
+  ASSERT_EQUAL(disabled.GetMetrics().ToJson().ToString(), R"({"phases_ms":{}, "requests":{}})");
+
+  TransportBase enabled;
+  enabled.GetMetrics().SetEnabled(true);
+  enabled.ConsumeRequests(requests);
+  Json::Node const stats = enabled.GetMetrics().ToJson();
+  Json::Map const & stop_base = stats.AsMap().at("requests").AsMap().at("stop_base").AsMap();
+  ASSERT_EQUAL(stop_base.at("requests").AsInt(), config.stop_count);
+  ASSERT(stop_base.at("map_lookups").IsType<int32_t>());
+  ASSERT(stop_base.at("allocations").IsType<int32_t>());
 }
 
-Json::Node const & Response::GetResponseBody() const {
-  return m_json;
+void TestMappedCatalogueRejectsBadLayout() {
+  bench::NetworkConfig config;
+  config.stop_count = 50;
+  config.bus_count = 10;
+  config.stat_count = 50;
+  std::stringstream network;
+  bench::GenerateNetworkJson(config, network);
+  std::vector<Request> requests = ParseRequestsJson(network);
+
+  std::string const path = (std::filesystem::temp_directory_path()
+                            / ("mapped_test_" + std::to_string(getpid()) + ".pack")).string();
+  mapped::PackCatalogue(requests, path);
+  TransportBase tb;
+  tb.ConsumeRequests(requests);
+  {
+    mapped::MappedCatalogue catalogue(path);
+    metrics::Metrics unused;
+    for (Request const & request : requests) {
+      if (request.GetType() == Request::Type::STAT) {
+        ASSERT_EQUAL(catalogue.AnswerStatRequest(request, unused).GetResponseBody().ToString(),
+                     tb.AnswerStatRequest(request, unused).GetResponseBody().ToString());
+      }
+    }
+  }
+
+  std::string packed;
+  {
+    std::ifstream input(path, std::ios::binary);
+    packed.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+  }
+  auto assert_rejected = [&path](std::string const & bytes, std::string const & hint) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+    try {
+      mapped::MappedCatalogue catalogue(path);
+      ASSERT(!"corrupt pack is rejected");
+    } catch (std::runtime_error const & e) {
+      ASSERT(std::string_view(e.what()).find(hint) != std::string_view::npos);
+    }
+  };
+  assert_rejected(packed.substr(0, packed.size() - 1), "out of file");
+  assert_rejected(packed.substr(0, 16), "shorter than header");
+  std::string old_version = packed;
+  old_version[6] = '0';
+  old_version[7] = '1';
+  assert_rejected(old_version, "unsupported version");
+  std::string bad_offset = packed;
+  // offset of the first section points past the end of file
+  uint64_t const far_offset = packed.size() + 4096;
+  std::memcpy(bad_offset.data() + 8, &far_offset, sizeof(far_offset));
+  assert_rejected(bad_offset, "out of file");
+
+  // sections are written at offsets stored in header after signature and version
+  auto corrupt = [&packed](mapped::Section section, size_t byte_offset, auto value) {
+    uint64_t section_offset;
+    std::memcpy(&section_offset, packed.data() + 8 + section * sizeof(mapped::SectionRecord), sizeof(section_offset));
+    std::string bytes = packed;
+    std::memcpy(bytes.data() + section_offset + byte_offset, &value, sizeof(value));
+    return bytes;
+  };
+  uint32_t const unknown_id = UINT32_MAX;
+  assert_rejected(corrupt(mapped::ROUTE_STOPS, 0, unknown_id), "has unknown id");
+  assert_rejected(corrupt(mapped::STOP_BUS_IDS, 0, unknown_id), "has unknown id");
+  assert_rejected(corrupt(mapped::STOP_NAME_ORDER, 0, unknown_id), "has unknown id");
+  assert_rejected(corrupt(mapped::DIST_ENTRIES, offsetof(mapped::DistanceRecord, to_stop), unknown_id),
+                  "has unknown id");
+  assert_rejected(corrupt(mapped::BUS_ROUTES, offsetof(mapped::RouteRecord, size), unknown_id),
+                  "out of route stops");
+  assert_rejected(corrupt(mapped::BUS_ROUTES, sizeof(mapped::RouteRecord) + offsetof(mapped::RouteRecord, offset),
+                          uint64_t(0)),
+                  "out of route stops");
+  // total length of names in place of the first name end
+  uint64_t names_size;
+  std::memcpy(&names_size, packed.data() + 8 + mapped::STOP_NAMES * sizeof(mapped::SectionRecord) + 8,
+              sizeof(names_size));
+  assert_rejected(corrupt(mapped::STOP_NAME_OFFSETS, sizeof(uint64_t), names_size), "doesn't match its values");
+  std::filesystem::remove(path);
 }
 
-void PrintResponses(std::ostream & out, std::vector<Response> responses) {
-  Json::Node result_response;
-  for (auto const & response : responses) {
-    result_response.AddValue(response.GetResponseBody());
+/**
+ * @brief Sends lines over socketpair to ServeStream of server,
+ * requests are written by separate thread while answers are read, as by pipelining client
+ */
+std::vector<std::string> ExchangeLines(server::CatalogueServer & catalogue_server,
+                                       std::vector<std::string> const & lines) {
+  int fds[2];
+  ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  std::thread serving([&catalogue_server, fd = fds[1]] { catalogue_server.ServeStream(fd, fd); });
+  std::thread sender([&lines, fd = fds[0]] {
+    for (std::string const & line : lines) {
+      server::WriteAll(fd, line + "\n");
+    }
+    shutdown(fd, SHUT_WR);
+  });
+
+  std::vector<std::string> answers;
+  server::LineReader reader(fds[0]);
+  for (std::string line; reader.ReadLine(line); ) {
+    answers.push_back(line);
+    if (answers.size() == lines.size()) {
+      break;
+    }
   }
-  out << result_response.ToString();
+  sender.join();
+  serving.join();
+  close(fds[0]);
+  close(fds[1]);
+  return answers;
 }
 
-std::vector<Request> ParseRequestsJson(std::istream & in) {
-  using namespace Json;
-  Document document = Load(in);
-  auto const & requests_dict = document.GetRoot().AsMap();
-  std::vector<Request> requests;
+void TestServeStreamMatchesTransportBase() {
+  bench::NetworkConfig config;
+  config.stop_count = 40;
+  config.bus_count = 10;
+  config.stat_count = 300;
+  std::stringstream network;
+  bench::GenerateNetworkJson(config, network);
+  std::string const text = network.str();
+  std::vector<Request> requests = ParseRequestsJson(network);
+  TransportBase tb;
+  tb.ConsumeRequests(requests);
+
+  std::vector<std::string> lines;
+  std::vector<std::string> expected;
+  metrics::Metrics unused;
+  Json::Document document = Json::Load(std::string_view(text));
+  for (Json::Node const & node : document.GetRoot().AsMap().at("stat_requests").AsArray()) {
+    lines.push_back(node.ToString());
+    expected.push_back(tb.AnswerStatRequest(Request(Request::Type::STAT, node), unused)
+                           .GetResponseBody().ToString());
+  }
+  lines.push_back("{\"id\": 1, \"type\":");
+  expected.push_back(R"({"error_message":"bad request"})");
+
+  server::ServerConfig server_config;
+  server_config.worker_count = 4;
+  server_config.queue_capacity = 8;
+  server_config.max_in_flight = 16;
+  server::CatalogueServer catalogue_server(tb, server_config);
+  ASSERT_EQUAL(ExchangeLines(catalogue_server, lines), expected);
+
+  // clients share pool, each gets own answers in order of its requests
+  std::vector<std::vector<std::string>> client_lines(4);
+  std::vector<std::vector<std::string>> client_expected(client_lines.size());
+  for (size_t i = 0; i < lines.size(); i++) {
+    client_lines[i % client_lines.size()].push_back(lines[i]);
+    client_expected[i % client_lines.size()].push_back(expected[i]);
+  }
+  std::vector<std::vector<std::string>> client_answers(client_lines.size());
+  std::vector<std::thread> clients;
+  for (size_t i = 0; i < client_lines.size(); i++) {
+    clients.emplace_back([&, i] { client_answers[i] = ExchangeLines(catalogue_server, client_lines[i]); });
+  }
+  for (std::thread & client : clients) {
+    client.join();
+  }
+  ASSERT_EQUAL(client_answers, client_expected);
+}
 
-  auto ParseRequestsFunc = [](std::string_view requests_key, Request::Type request_type,
-                              Map _requests_dict, std::vector<Request> & _requests)
-  -> void {
-    Node const & base_node_req = _requests_dict.at(std::string(requests_key));
-    std::vector<Node> const & req_arr = base_node_req.AsArray();
-    for (Node const & req : req_arr) {
-      _requests.emplace_back(request_type, req);
+void TestServeStreamSurvivesDroppedClient() {
+  bench::NetworkConfig config;
+  config.stop_count = 20;
+  config.bus_count = 5;
+  config.stat_count = 20;
+  std::stringstream network;
+  bench::GenerateNetworkJson(config, network);
+  std::vector<Request> requests = ParseRequestsJson(network);
+  TransportBase tb;
+  tb.ConsumeRequests(requests);
+
+  server::ServerConfig server_config;
+  server_config.worker_count = 2;
+  server_config.max_in_flight = 4;
+  server::CatalogueServer catalogue_server(tb, server_config);
+  std::string const line = R"({"id": 1, "type": "Stop", "name": "missing"})";
+
+  int fds[2];
+  ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  std::thread serving([&catalogue_server, fd = fds[1]] { catalogue_server.ServeStream(fd, fd); });
+  // client stops reading after first answer and closes its end while requests are still coming
+  std::thread sender([&line, fd = fds[0]] {
+    for (int i = 0; i < 100000 && server::WriteAll(fd, line + "\n"); i++) {
     }
-  };
+  });
+  server::LineReader reader(fds[0]);
+  std::string answer;
+  ASSERT(reader.ReadLine(answer));
+  shutdown(fds[0], SHUT_RDWR);
+  sender.join();
+  serving.join();
+  close(fds[0]);
+  close(fds[1]);
+
+  ASSERT_EQUAL(ExchangeLines(catalogue_server, {line}), std::vector<std::string>{answer});
+}
 
-  ParseRequestsFunc(BASE_REQUESTS, Request::Type::BASE, requests_dict, requests);
-  ParseRequestsFunc(STAT_REQUESTS, Request::Type::STAT, requests_dict, requests);
+void TestParseNumber() {
+  auto as_double = [](std::string_view token) {
+    return Json::ParseNumber(token)->AsDouble();
+  };
+  ASSERT_EQUAL(Json::ParseNumber("42")->AsInt(), 42);
+  ASSERT_EQUAL(Json::ParseNumber("-2147483648")->AsInt(), INT32_MIN);
+  ASSERT(Json::ParseNumber("2147483648")->IsType<double>());
+  ASSERT_EQUAL(as_double("2147483648"), 2147483648.0);
+  ASSERT_EQUAL(as_double("-9007199254740992"), -9007199254740992.0);
+  ASSERT_EQUAL(as_double("55.611087"), 55.611087);
+  ASSERT_EQUAL(as_double("-37.20829"), -37.20829);
+  ASSERT_EQUAL(as_double("0.000123"), 0.000123);
+  ASSERT_EQUAL(as_double("1.5e3"), 1500.0);
+  ASSERT_EQUAL(as_double("25E-2"), 0.25);
+  ASSERT_EQUAL(as_double("1.7976931348623157e308"), 1.7976931348623157e308);
+  ASSERT_EQUAL(as_double("4.9406564584124654e-324"), 4.9406564584124654e-324);
+  ASSERT_EQUAL(as_double("3.14159265358979323846264338327950288"), 3.14159265358979323846264338327950288);
+
+  for (std::string_view bad : {"", "-", "01", "1.", ".5", "1e", "1e+", "+1", "0x10", "nan", "1.2.3",
+                               "1\xB2", "\xD9\xA3", "1.\xB9", "1e\xB3"}) {
+    ASSERT(!Json::ParseNumber(bad));
+  }
+}
 
-  return requests;
+void TestNumbersRoundTrip() {
+  std::mt19937_64 rng(11);
+  std::uniform_real_distribution<double> coordinate(-180.0, 180.0);
+  for (int i = 0; i < 10000; i++) {
+    double value = coordinate(rng);
+    char buffer[64];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    ASSERT_EQUAL(Json::ParseNumber(std::string_view(buffer, result.ptr - buffer))->AsDouble(), value);
+  }
 }
 
-void TransportBase::AddBus(bus_model::BusPtr bus) {
-  m_buses[bus->GetName()] = bus;
-  UpdateStops(bus->GetName());
+void TestLoadRejectsTruncatedInput() {
+  for (std::string_view input : {"[1, 2", R"({"a": )", R"({"a" 1})"}) {
+    try {
+      Json::Load(input);
+      Assert(false, "Json::Load should throw Json::ParseError for " + std::string(input));
+    }
+    catch (Json::ParseError &) {
+    }
+  }
 }
 
-void TransportBase::AddStop(bus_model::StopPtr stop) {
-  m_stops[stop->GetName()] = stop;
-  m_stop_name_and_bus_names[stop->GetName()];
+void TestLazyMatchesLoad() {
+  bench::NetworkConfig config;
+  config.stop_count = 50;
+  config.bus_count = 10;
+  config.stat_count = 50;
+  std::ostringstream network;
+  bench::GenerateNetworkJson(config, network);
+
+  Json::Document eager = Json::Load(std::string_view(network.str()));
+  Json::LazyDocument lazy(network.str());
+  Json::Map const & eager_root = eager.GetRoot().AsMap();
+  Json::LazyMap lazy_root = lazy.GetRoot().AsMap();
+  ASSERT_EQUAL(lazy_root.size(), eager_root.size());
+
+  Json::Array const & eager_requests = eager_root.at("base_requests").AsArray();
+  Json::LazyArray lazy_requests = lazy_root.at("base_requests").AsArray();
+  ASSERT_EQUAL(lazy_requests.size(), eager_requests.size());
+  for (size_t i = 0; i < eager_requests.size(); i++) {
+    Json::Map const & eager_request = eager_requests[i].AsMap();
+    Json::LazyMap lazy_request = lazy_requests[i].AsMap();
+    ASSERT_EQUAL(lazy_request.at("type").AsString(), eager_request.at("type").AsString());
+    ASSERT_EQUAL(lazy_request.at("name").AsString(), eager_request.at("name").AsString());
+    if (auto it = eager_request.find("latitude"); it != eager_request.end()) {
+      ASSERT_EQUAL(lazy_request.at("latitude").AsDouble(), it->second.AsDouble());
+    }
+    AssertNodesEqual(lazy_requests[i].Materialize(), eager_requests[i]);
+  }
+  AssertNodesEqual(lazy.GetRoot().Materialize(), eager.GetRoot());
 }
 
-std::vector<Response> TransportBase::ConsumeRequests(std::vector<Request> requests) {
-  std::vector<Response> responses;
-  for (Request const & request : requests) {
-    switch (request.GetType()) {
-      case Request::Type::BASE:
-      {
-        if (request.GetRequestBody().AsMap().find(TYPE)->second.AsString() == BUS_STR) {
-          AddBus(ParseBus(request));
-        }
-        else {
-          AddStop(ParseStop(request));
-        }
+void TestLazyDecodesOnlyTouched() {
+  Json::LazyDocument document(R"({"skip": {"a": [1e, 2.], "b": 0x1}, "id": 7, "id": 8, "list": [true, "s", 1.5]})");
+  Json::LazyMap root = document.GetRoot().AsMap();
+  ASSERT_EQUAL(root.at("id").AsInt(), 7);
+  Json::LazyDocument escaped(R"({"a\"b": "\u0410", "a\\b": 2})");
+  ASSERT_EQUAL(escaped.GetRoot().AsMap().at("a\"b").AsString(), "\xd0\x90");
+  ASSERT_EQUAL(escaped.GetRoot().AsMap().at("a\\b").AsInt(), 2);
+  ASSERT_EQUAL(root.count("missing"), 0u);
+  ASSERT(root.at("list").AsArray()[0].AsBool());
+  ASSERT_EQUAL(root.at("list").AsArray()[1].AsString(), "s");
+  ASSERT_EQUAL(root.at("list").AsArray()[2].AsDouble(), 1.5);
+  ASSERT_EQUAL(root.at("id").AsDouble(), 7.0);
+  ASSERT_EQUAL(root.at("skip").AsMap().size(), 2u);
+  for (auto access : {+[](Json::LazyNode node) { node.AsInt(); }, +[](Json::LazyNode node) { node.AsBool(); }}) {
+    for (std::string_view key : {"list", "skip"}) {
+      try {
+        access(root.at(key));
+        Assert(false, "scalar access to container should throw std::bad_variant_access");
       }
-        break;
-      case Request::Type::STAT:
-      {
-        if (request.GetRequestBody().AsMap().find(TYPE)->second.AsString() == BUS_STR) {
-          responses.emplace_back(CalculateStatForBus(ParseBus(request)->GetName()).ToJson(), request.GetId());
-        }
-        else {
-          responses.emplace_back(CalculateStatForStop(ParseStop(request)->GetName()).ToJson(), request.GetId());
-        }
+      catch (std::bad_variant_access &) {
       }
-        break;
     }
   }
+  try {
+    root.at("list").AsArray()[0].AsInt();
+    Assert(false, "AsInt of bool should throw std::bad_variant_access");
+  }
+  catch (std::bad_variant_access &) {
+  }
 
-  return responses;
+  try {
+    root.at("skip").AsMap().at("b").AsInt();
+    Assert(false, "bad number should throw Json::ParseError when touched");
+  }
+  catch (Json::ParseError &) {
+  }
+  try {
+    root.at("list").AsArray()[3];
+    Assert(false, "index past the end should throw std::out_of_range");
+  }
+  catch (std::out_of_range &) {
+  }
+  for (std::string_view input : {"[1, 2", "[1}", R"({"a": 1}})", ""}) {
+    try {
+      Json::LazyDocument bad{std::string(input)};
+      Assert(false, "Json::LazyDocument should throw Json::ParseError for " + std::string(input));
+    }
+    catch (Json::ParseError &) {
+    }
+  }
 }
 
-TransportBase::BusStat TransportBase::CalculateStatForBus(std::string_view bus_name) const {
-  auto it = m_buses.find(bus_name);
-  if (it != m_buses.end()) {
-    std::vector<std::string> const & route = it->second->GetRoute();
-    std::unordered_set<std::string_view> s;
-    long double dist_earth = 0.0;
-    int32_t dist_road = 0.0;
-    bus_model::StopPtr prev_stop = nullptr;
-    for (auto const & stop_name : route) {
-      bus_model::StopPtr stop = m_stops.find(stop_name)->second;
-      if (prev_stop) {
-        int32_t di1 = prev_stop->GetDistanceBetweenStop(stop->GetName());
-        if (di1 == -1) {
-          dist_road += stop->GetDistanceBetweenStop(prev_stop->GetName());
-        }
-        else {
-          dist_road += di1;
-        }
-
-        auto point1 = prev_stop->GetPoint();
-        auto point2 = stop->GetPoint();
-        dist_earth += geom2d::CalculateDistance(prev_stop->GetPoint(), stop->GetPoint());
-      }
-      prev_stop = stop;
-      s.insert(stop->GetName());
+void TestLazyRejectsBadSeparators() {
+  for (std::string_view input : {"[1,]", R"({"a": 1,})", "[,1]", "[1 2]", "[1,,2]", R"({"a" 1})", R"({"a":: 1})",
+                                 R"({: 1})", R"({"a": 1 "b": 2})", R"({"a", "b"})", R"({1: 2})", R"(["a": 1])",
+                                 R"({"a"})", R"({"a":})", "[1] [2]", "1 2", ",", "[[]:]"}) {
+    try {
+      Json::LazyDocument bad{std::string(input)};
+      Assert(false, "Json::LazyDocument should throw Json::ParseError for " + std::string(input));
     }
+    catch (Json::ParseError &) {
+    }
+  }
+  for (std::string_view input : {"[]", "{}", "[[], {}]", R"({"a": [1, {"b": "c"}], "d": {}})", "7", R"("s")"}) {
+    Json::LazyDocument document{std::string(input)};
+    ASSERT_EQUAL(document.GetRoot().Materialize().ToString(), Json::Load(input).GetRoot().ToString());
+  }
+}
 
-    return {.bus_name = std::string(bus_name),
-            .is_found = true,
-            .stops_count = static_cast<int32_t>(route.size()),
-            .unique_stop_count = static_cast<int32_t>(s.size()),
-            .route_length = dist_road,
-            .curvature = geom2d::CalculateCurvature(dist_road, dist_earth)};
+void TestCompactNode() {
+  ASSERT(sizeof(Json::Node) <= 16);
+  Json::Node empty;
+  ASSERT(empty.IsType<Json::Array>());
+  ASSERT(empty.AsArray().empty());
+
+  Json::Node original(Json::Map{{"a", Json::Node(1)}, {"b", Json::Node("text")}});
+  original.AddValue(Json::Node(Json::Array{Json::Node(true), Json::Node(2.5)}), "c");
+  Json::Node copy = original;
+  original.AddValue(Json::Node(0), "a");
+  ASSERT_EQUAL(copy.AsMap().at("a").AsInt(), 1);
+  ASSERT_EQUAL(original.AsMap().at("a").AsInt(), 0);
+  ASSERT_EQUAL(copy.AsMap().at("b").AsString(), "text");
+  ASSERT_EQUAL(copy.AsMap().at("c").AsArray()[1].AsDouble(), 2.5);
+
+  Json::Node moved = std::move(copy);
+  ASSERT_EQUAL(moved.AsMap().size(), 3u);
+  copy = moved.AsMap().at("c");
+  ASSERT_EQUAL(copy.ToString(), "[true, 2.5]");
+
+  try {
+    moved.AsArray();
+    Assert(false, "AsArray of map should throw std::bad_variant_access");
+  }
+  catch (std::bad_variant_access &) {
+  }
+}
+
+void TestLoadParallelMatchesLoad() {
+  bench::NetworkConfig config;
+  config.stop_count = 3000;
+  config.bus_count = 300;
+  config.stat_count = 5000;
+  std::ostringstream network;
+  bench::GenerateNetworkJson(config, network);
+
+  Json::Document eager = Json::Load(std::string_view(network.str()));
+  for (size_t thread_count : {1, 3, 8}) {
+    std::istringstream input(network.str());
+    AssertNodesEqual(Json::LoadParallel(input, thread_count).GetRoot(), eager.GetRoot());
   }
 
-  return {.bus_name = std::string(bus_name),
-          .is_found = false};
+  std::string elements;
+  for (int i = 0; i < 100000; i++) {
+    elements += std::to_string(i) + ",";
+  }
+  std::istringstream array_input("[" + elements + "[]]");
+  Json::Document document = Json::LoadParallel(array_input, 4);
+  Json::Array const & array = document.GetRoot().AsArray();
+  ASSERT_EQUAL(array.size(), 100001u);
+  for (int i = 0; i < 100000; i++) {
+    ASSERT_EQUAL(array[i].AsInt(), i);
+  }
+
+  std::istringstream bad_input("[" + elements + "tru]");
+  try {
+    Json::LoadParallel(bad_input, 4);
+    Assert(false, "Json::LoadParallel should throw Json::ParseError for bad element");
+  }
+  catch (Json::ParseError &) {
+  }
 }
 
-TransportBase::StopStat TransportBase::CalculateStatForStop(std::string_view stop_name) const {
-  auto it = m_stop_name_and_bus_names.find(stop_name);
-  if (it != m_stop_name_and_bus_names.end()) {
-    std::vector<std::string> buses(it->second.begin(), it->second.end());
-    return {.stop_name = std::string(stop_name),
-            .is_found = true,
-            .buses = std::move(buses)};
+void TestBindMatchesNode() {
+  using StopTable = Json::schema_detail::SchemaTable<StopRequestBody>;
+  static_assert(StopTable::table.Find("name") == 0);
+  static_assert(StopTable::table.Find("road_distances") == 4);
+  static_assert(StopTable::table.Find("type") == -1);
+
+  std::string_view stop_text = R"({"type": "Stop", "name": "Tolstopaltsevo", "latitude": 55.611087,
+    "longitude": 37.20829, "extra": {"a": [1, {"b": "}"}]}, "road_distances": {"Marushkino": 3900, "Rasskazovka": 9500},
+    "name": "duplicate"})";
+  StopRequestBody from_text = Json::BindText<StopRequestBody>(stop_text);
+  StopRequestBody from_node = Json::BindNode<StopRequestBody>(Json::Load(stop_text).GetRoot());
+  for (StopRequestBody const & stop : {from_text, from_node}) {
+    ASSERT_EQUAL(stop.name, "Tolstopaltsevo");
+    ASSERT(!stop.id);
+    ASSERT_EQUAL(*stop.latitude, 55.611087);
+    ASSERT_EQUAL(*stop.longitude, 37.20829);
+    ASSERT_EQUAL(stop.road_distances, (std::map<std::string, int32_t>{{"Marushkino", 3900}, {"Rasskazovka", 9500}}));
   }
 
-  return {.stop_name = std::string(stop_name),
-          .is_found = false,
-          .buses = {}};
+  std::string_view bus_text = R"({"id": 3, "name": "256", "stops": ["A", "B", "C"], "is_roundtrip": true})";
+  for (BusRequestBody const & bus : {Json::BindText<BusRequestBody>(bus_text),
+                                     Json::BindNode<BusRequestBody>(Json::Load(bus_text).GetRoot())}) {
+    ASSERT_EQUAL(bus.name, "256");
+    ASSERT_EQUAL(*bus.stops, (std::vector<std::string>{"A", "B", "C"}));
+    ASSERT(bus.is_roundtrip);
+  }
+  ASSERT(!Json::BindText<BusRequestBody>(R"({"name": "750"})").stops);
 }
 
-void TransportBase::UpdateStops(std::string_view bus_name) {
-  auto bus_it = m_buses.find(bus_name);
-  if (bus_it != m_buses.end()) {
-    auto const & route = bus_it->second->GetRoute();
-    for (std::string_view stop_name : route) {
-      m_stop_name_and_bus_names[stop_name].insert(bus_name);
+void TestBindRejectsBadInput() {
+  for (std::string_view input : {R"({"latitude": 1.5})", R"({"name": 1})", R"({"name": "A", "id": 1.5})",
+                                 R"({"name": "A", "road_distances": {"B": "far"}})", R"({"name": "A")",
+                                 R"({"name": "A"} [])", R"(["name"])"}) {
+    try {
+      Json::BindText<StopRequestBody>(input);
+      Assert(false, "BindText should throw Json::ParseError for " + std::string(input));
     }
+    catch (Json::ParseError &) {
+    }
+  }
+  try {
+    Json::BindNode<BusRequestBody>(Json::Load(std::string_view(R"({"name": "A", "stops": [1]})")).GetRoot());
+    Assert(false, "BindNode should throw Json::ParseError for number in stops");
+  }
+  catch (Json::ParseError &) {
+  }
+  try {
+    Json::BindNode<StopRequestBody>(Json::Load(std::string_view(R"({"name": "A", "id": 1.5})")).GetRoot());
+    Assert(false, "BindNode should throw Json::ParseError for fractional id");
+  }
+  catch (Json::ParseError & e) {
+    ASSERT_EQUAL(std::string(e.what()), "expected int32, got 1.5");
   }
 }
 
-bus_model::BusPtr TransportBase::ParseBus(Request const & request) {
-  Json::Map const & req_body = request.GetRequestBody().AsMap();
-  bus_model::BusPtr bus = std::make_shared<bus_model::Bus>(req_body.find(NAME)->second.AsString());
-
-  if (auto it = req_body.find(STOPS); it != req_body.end()) {
-    std::vector<std::string> route;
+std::string ToHex(std::string_view bytes) {
+  static constexpr char DIGITS[] = "0123456789abcdef";
+  std::string result;
+  for (char c : bytes) {
+    result += DIGITS[static_cast<uint8_t>(c) >> 4];
+    result += DIGITS[static_cast<uint8_t>(c) & 0xF];
+  }
+  return result;
+}
 
-    std::vector<Json::Node> const & stops = it->second.AsArray();
-    bool is_roundtrip = req_body.find(IS_ROUNDTRIP)->second.AsBool();
+void TestCborMatchesRfcExamples() {
+  std::vector<std::pair<std::string_view, std::string_view>> examples = {
+    {"0", "00"}, {"23", "17"}, {"24", "1818"}, {"100", "1864"}, {"1000", "1903e8"},
+    {"-1", "20"}, {"-1000", "3903e7"}, {"1.1", "fb3ff199999999999a"}, {"true", "f5"},
+    {R"("a")", "6161"}, {"[1, 2, 3]", "83010203"}, {R"({"a": 1, "b": [2, 3]})", "a26161016162820203"},
+  };
+  for (auto const & [text, hex] : examples) {
+    Json::Node node = Json::Load(text).GetRoot();
+    std::string cbor = Json::EncodeCbor(node);
+    ASSERT_EQUAL(ToHex(cbor), hex);
+    AssertNodesEqual(Json::DecodeCbor(cbor).GetRoot(), node);
+  }
+  // half, single precision floats and 64-bit integers written by other encoders
+  ASSERT_EQUAL(Json::DecodeCbor(std::string("\xf9\x3e\x00", 3)).GetRoot().AsDouble(), 1.5);
+  ASSERT_EQUAL(Json::DecodeCbor(std::string("\xfa\x47\xc3\x50\x00", 5)).GetRoot().AsDouble(), 100000.0);
+  ASSERT_EQUAL(Json::DecodeCbor(std::string("\x1b\x00\x00\x00\xe8\xd4\xa5\x10\x00", 9)).GetRoot().AsDouble(), 1e12);
+}
 
-    for (Json::Node const & node : stops) {
-      std::string const & stop_name = node.AsString();
-      route.push_back(stop_name);
+void TestCborRoundTripsText() {
+  bench::NetworkConfig config;
+  config.stop_count = 200;
+  config.bus_count = 30;
+  config.stat_count = 200;
+  std::ostringstream network;
+  bench::GenerateNetworkJson(config, network);
+
+  Json::Document text = Json::Load(std::string_view(network.str()));
+  std::string cbor = Json::EncodeCbor(text.GetRoot());
+  Json::Document binary = Json::DecodeCbor(cbor);
+  AssertNodesEqual(binary.GetRoot(), text.GetRoot());
+  ASSERT_EQUAL(binary.GetRoot().ToString(), text.GetRoot().ToString());
+  ASSERT_EQUAL(Json::EncodeCbor(binary.GetRoot()), cbor);
+
+  for (size_t size = 0; size < 64; size++) {
+    try {
+      Json::DecodeCbor(std::string_view(cbor).substr(0, size));
+      Assert(false, "DecodeCbor should throw Json::ParseError for truncated data");
     }
-
-    if (!is_roundtrip) {
-      route.reserve(route.size() * 2 - 1);
-      for (int32_t i = route.size() - 2; i >= 0; i--) {
-        route.push_back(route[i]);
-      }
+    catch (Json::ParseError &) {
     }
+  }
+}
 
-    bus->SetRoute(std::move(route));
+void TestCborRejectsDeepNesting() {
+  // arrays of one element each around int 0
+  auto nested = [](size_t depth) {
+    return std::string(depth, '\x81') + '\0';
+  };
+  Json::Document document = Json::DecodeCbor(nested(Json::CBOR_MAX_DEPTH));
+  Json::Node const * node = &document.GetRoot();
+  for (size_t i = 0; i < Json::CBOR_MAX_DEPTH; i++) {
+    node = &node->AsArray().at(0);
   }
+  ASSERT_EQUAL(node->AsInt(), 0);
 
-  return bus;
+  for (size_t depth : {Json::CBOR_MAX_DEPTH + 1, size_t(1) << 20}) {
+    try {
+      Json::DecodeCbor(nested(depth));
+      Assert(false, "DecodeCbor should throw Json::ParseError for depth " + std::to_string(depth));
+    }
+    catch (Json::ParseError &) {
+    }
+  }
 }
 
-bus_model::StopPtr TransportBase::ParseStop(Request const & request) {
-  Json::Map const & req_body = request.GetRequestBody().AsMap();
-
-  bus_model::StopPtr stop =
-          std::make_shared<bus_model::Stop>(req_body.find(NAME)->second.AsString());
+void TestNdjsonRoundTrip() {
+  std::vector<Json::Node> records = {
+    Json::Node(Json::Map{{"id", Json::Node(1)}, {"type", Json::Node("Bus")}, {"name", Json::Node("256")}}),
+    Json::Node(Json::Array{Json::Node(1.5), Json::Node(false)}),
+    Json::Node(7),
+    Json::Node(Json::Map{}),
+  };
+  std::ostringstream output;
+  {
+    Json::NdjsonWriter writer(output, 16);
+    for (Json::Node const & record : records) {
+      writer.Write(record);
+    }
+  }
 
-  if (req_body.find(ID) == req_body.end()) {
-    double lat = req_body.find(LATITUDE)->second.AsDouble();
-    double lon = req_body.find(LONGITUDE)->second.AsDouble();
-    stop->SetPoint(geom2d::PointD(lat, lon));
+  std::istringstream input("\n" + output.str() + "  \n");
+  Json::NdjsonReader reader(input);
+  Json::Node node;
+  for (Json::Node const & record : records) {
+    ASSERT(reader.Next(node));
+    AssertNodesEqual(node, record);
+  }
+  ASSERT(!reader.Next(node));
+  ASSERT_EQUAL(reader.GetLineNumber(), records.size() + 2);
+}
 
-    if (auto it = req_body.find(ROAD_DISTANCES); it != req_body.end()) {
-      Json::Map const & road_dists = it->second.AsMap();
-      for (auto const & [name, dist] : road_dists) {
-       stop->SetDistanceBetweenStop(name, dist.AsInt());
-      }
-    }
+void TestNdjsonReportsBadLine() {
+  std::istringstream input("{\"id\": 1}\n[1, 2\n{\"id\": 3}\n");
+  Json::NdjsonReader reader(input);
+  Json::Node node;
+  ASSERT(reader.Next(node));
+  try {
+    reader.Next(node);
+    Assert(false, "NdjsonReader should throw Json::ParseError for truncated record");
   }
+  catch (Json::ParseError & error) {
+    ASSERT_EQUAL(std::string(error.what()).rfind("line 2:", 0), 0u);
+  }
+  ASSERT(reader.Next(node));
+  ASSERT_EQUAL(node.AsMap().at("id").AsInt(), 3);
+}
 
-  return stop;
+int TestAll(int argc, char * argv[]) {
+  TestRunner tr;
+  RUN_TEST(tr, TestCompactNode);
+  RUN_TEST(tr, TestPrintDoubles);
+  RUN_TEST(tr, TestStringEscapes);
+  RUN_TEST(tr, TestStructuralsOfEscapedQuotes);
+  RUN_TEST(tr, TestStructuralsMatchNaive);
+  RUN_TEST(tr, TestLoadMatchesStreamLoader);
+  RUN_TEST(tr, TestGeneratedRoutesHaveNoRepeatedStops);
+  RUN_TEST(tr, TestMetricsOnlyWhenEnabled);
+  RUN_TEST(tr, TestMappedCatalogueRejectsBadLayout);
+  RUN_TEST(tr, TestServeStreamMatchesTransportBase);
+  RUN_TEST(tr, TestServeStreamSurvivesDroppedClient);
+  RUN_TEST(tr, TestParseNumber);
+  RUN_TEST(tr, TestNumbersRoundTrip);
+  RUN_TEST(tr, TestLoadRejectsTruncatedInput);
+  RUN_TEST(tr, TestLazyMatchesLoad);
+  RUN_TEST(tr, TestLazyDecodesOnlyTouched);
+  RUN_TEST(tr, TestLazyRejectsBadSeparators);
+  RUN_TEST(tr, TestLoadParallelMatchesLoad);
+  RUN_TEST(tr, TestNdjsonRoundTrip);
+  RUN_TEST(tr, TestNdjsonReportsBadLine);
+  RUN_TEST(tr, TestBindMatchesNode);
+  RUN_TEST(tr, TestBindRejectsBadInput);
+  RUN_TEST(tr, TestCborMatchesRfcExamples);
+  RUN_TEST(tr, TestCborRoundTripsText);
+  RUN_TEST(tr, TestCborRejectsDeepNesting);
+  return tr.Run(argc, argv);
 }
+} // namespace json_test
 
 //------------------------main.cpp--------------------------------------------
+#include <fstream>
 #include <iostream>
 
-int main() {
+/**
+ * Usage:
+ *   src                       - answer requests json from stdin
+ *   src gen [key=value ...]   - print synthetic requests json
+ *   src bench [key=value ...] - benchmark TransportBase on synthetic requests
+ *   src metrics               - answer requests json from stdin, print metrics json to stderr at exit
+ *   src serve BASE [SOCKET_PATH] [workers=N] [queue=N] [metrics=1]
+ *                             - load base once, answer newline-delimited stat requests
+ *                               from unix socket until SIGINT or SIGTERM or, without
+ *                               SOCKET_PATH, from stdin; BASE is base requests json or
+ *                               packed catalogue; metrics=1 prints metrics json to stderr at exit
+ *   src client SOCKET_PATH    - send stdin lines to server socket, print answers
+ *   src pack BASE_JSON PACKED - write packed catalogue for memory-mapped serving
+ *   src query PACKED          - answer stat requests json from stdin by packed catalogue
+ *   src test [--filter=GLOBS] [--slowest=N]
+ *                             - run unit tests matching comma separated globs
+ * Metrics count allocations only in builds with -DCOUNT_ALLOCATIONS, which replace global
+ * operator new and delete, in other builds allocations are 0
+ */
+int main(int argc, char * argv[]) {
+  std::string_view mode = argc > 1 ? argv[1] : "";
+  if (mode == "test") {
+    return json_test::TestAll(argc - 1, argv + 1);
+  }
+  if (mode == "serve" && argc > 2) {
+    std::unique_ptr<StatCatalogue> catalogue;
+    if (mapped::IsPackedCatalogue(argv[2])) {
+      catalogue = std::make_unique<mapped::MappedCatalogue>(argv[2]);
+    } else {
+      std::ifstream base_input(argv[2]);
+      if (!base_input) {
+        std::cerr << "can't open " << argv[2] << std::endl;
+        return 1;
+      }
+      auto tb = std::make_unique<TransportBase>();
+      tb->ConsumeRequests(ParseRequestsJson(base_input));
+      catalogue = std::move(tb);
+    }
+
+    server::ServerConfig config;
+    std::string socket_path;
+    for (int i = 3; i < argc; i++) {
+      std::string_view arg = argv[i];
+      if (arg.substr(0, 8) == "workers=") {
+        config.worker_count = std::stoul(std::string(arg.substr(8)));
+      } else if (arg.substr(0, 6) == "queue=") {
+        config.queue_capacity = std::stoul(std::string(arg.substr(6)));
+      } else if (arg.substr(0, 8) == "metrics=") {
+        config.collect_metrics = arg.substr(8) == "1";
+      } else if (socket_path.empty() && arg.find('=') == std::string_view::npos) {
+        socket_path = std::string(arg);
+      } else {
+        std::cerr << "unknown serve option " << arg << std::endl;
+        return 1;
+      }
+    }
+
+    server::CatalogueServer catalogue_server(*catalogue, config);
+    if (socket_path.empty()) {
+      catalogue_server.ServeStream(STDIN_FILENO, STDOUT_FILENO);
+    } else {
+      server::StopOnSignals(catalogue_server);
+      catalogue_server.ServeUnixSocket(socket_path);
+    }
+    if (config.collect_metrics) {
+      std::cerr << catalogue_server.CollectMetrics().ToJson().ToString() << std::endl;
+    }
+    return 0;
+  }
+  if (mode == "pack" && argc > 3) {
+    std::ifstream base_input(argv[2]);
+    if (!base_input) {
+      std::cerr << "can't open " << argv[2] << std::endl;
+      return 1;
+    }
+    mapped::PackCatalogue(ParseRequestsJson(base_input), argv[3]);
+    return 0;
+  }
+  if (mode == "query" && argc > 2) {
+    mapped::MappedCatalogue catalogue(argv[2]);
+    metrics::Metrics query_metrics;
+    std::vector<Response> responses;
+    for (Request const & request : ParseRequestsJson(std::cin)) {
+      if (request.GetType() == Request::Type::STAT) {
+        responses.push_back(catalogue.AnswerStatRequest(request, query_metrics));
+      }
+    }
+    PrintResponses(std::cout, std::move(responses));
+    return 0;
+  }
+  if (mode == "client" && argc > 2) {
+    server::RunClient(argv[2], std::cin, std::cout);
+    return 0;
+  }
+  if (mode == "gen" || mode == "bench") {
+    bench::NetworkConfig config = bench::ParseNetworkConfig({argv + 2, argv + argc});
+    if (mode == "gen") {
+      bench::GenerateNetworkJson(config, std::cout);
+    } else {
+      bench::RunBenchmark(config, std::cout);
+    }
+    return 0;
+  }
+
   TransportBase tb;
+  if (mode == "metrics") {
+    tb.GetMetrics().SetEnabled(true);
+    std::vector<Request> requests;
+    {
+      metrics::PhaseTimer timer(tb.GetMetrics(), "parse");
+      requests = ParseRequestsJson(std::cin);
+    }
+    std::vector<Response> responses = tb.ConsumeRequests(std::move(requests));
+    {
+      metrics::PhaseTimer timer(tb.GetMetrics(), "serialize");
+      PrintResponses(std::cout, std::move(responses));
+    }
+    std::cerr << tb.GetMetrics().ToJson().ToString() << std::endl;
+    return 0;
+  }
+
   PrintResponses(std::cout, tb.ConsumeRequests(ParseRequestsJson(std::cin)));
   return 0;
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "json.h"
+#include "json_scanner.h"
 
+#include <charconv>
+
+namespace Json {
 Node::Node(vector<Node> array) : as_array(move(array)) {
 }
 
@@ -35,6 +39,200 @@ const Node& Document::GetRoot() const {
     return root;
 }
 
+namespace {
+    uint32_t ReadHex4(string_view raw, size_t pos) {
+        uint32_t code = 0;
+        auto [ptr, ec] = from_chars(raw.data() + min(pos, raw.size()), raw.data() + min(pos + 4, raw.size()), code, 16);
+        if (ec != errc() || ptr != raw.data() + pos + 4) {
+            throw ParseError("bad \\u escape in \"" + string(raw) + "\"");
+        }
+        return code;
+    }
+
+    void AppendUtf8(uint32_t code, string& output) {
+        if (code < 0x80) {
+            output += static_cast<char>(code);
+        }
+        else if (code < 0x800) {
+            output += static_cast<char>(0xC0 | (code >> 6));
+            output += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else if (code < 0x10000) {
+            output += static_cast<char>(0xE0 | (code >> 12));
+            output += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            output += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else {
+            output += static_cast<char>(0xF0 | (code >> 18));
+            output += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            output += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            output += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+}
+
+string DecodeString(string_view raw) {
+    size_t pos = raw.find('\\');
+    if (pos == string_view::npos) {
+        return string(raw);
+    }
+
+    string result;
+    result.reserve(raw.size());
+    size_t done = 0;
+    for (; pos != string_view::npos; pos = raw.find('\\', done)) {
+        result.append(raw.substr(done, pos - done));
+        if (pos + 1 == raw.size()) {
+            throw ParseError("unfinished escape in \"" + string(raw) + "\"");
+        }
+        done = pos + 2;
+        switch (char c = raw[pos + 1]) {
+        case '"': case '\\': case '/':
+            result += c;
+            break;
+        case 'b':
+            result += '\b';
+            break;
+        case 'f':
+            result += '\f';
+            break;
+        case 'n':
+            result += '\n';
+            break;
+        case 'r':
+            result += '\r';
+            break;
+        case 't':
+            result += '\t';
+            break;
+        case 'u': {
+            uint32_t code = ReadHex4(raw, done);
+            done += 4;
+            if (code >= 0xD800 && code <= 0xDBFF) {
+                // characters outside of BMP are written as surrogate pair
+                uint32_t low = raw.substr(done, 2) == "\\u" ? ReadHex4(raw, done + 2) : 0;
+                if (low < 0xDC00 || low > 0xDFFF) {
+                    throw ParseError("unpaired surrogate in \"" + string(raw) + "\"");
+                }
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                done += 6;
+            }
+            else if (code >= 0xDC00 && code <= 0xDFFF) {
+                throw ParseError("unpaired surrogate in \"" + string(raw) + "\"");
+            }
+            AppendUtf8(code, result);
+            break;
+        }
+        default:
+            throw ParseError(string("bad escape \\") + c + " in \"" + string(raw) + "\"");
+        }
+    }
+    result.append(raw.substr(done));
+    return result;
+}
+
+namespace {
+    // Position of first char from pos that should be escaped: quote, backslash or control character
+    size_t FindEscaped(string_view text, size_t pos) {
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control_max = _mm_set1_epi8(0x1F);
+        for (; pos + 16 <= text.size(); pos += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+            __m128i is_escaped = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                _mm_cmpeq_epi8(_mm_max_epu8(chunk, control_max), control_max));
+            if (int mask = _mm_movemask_epi8(is_escaped)) {
+                return pos + __builtin_ctz(static_cast<unsigned>(mask));
+            }
+        }
+#endif
+        for (; pos < text.size(); pos++) {
+            unsigned char c = text[pos];
+            if (c == '"' || c == '\\' || c < 0x20) {
+                return pos;
+            }
+        }
+        return text.size();
+    }
+}
+
+void EscapeString(string_view text, string& output) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    size_t done = 0;
+    for (size_t pos = FindEscaped(text, 0); pos < text.size(); pos = FindEscaped(text, done)) {
+        output.append(text.substr(done, pos - done));
+        unsigned char c = text[pos];
+        switch (c) {
+        case '"':
+            output += "\\\"";
+            break;
+        case '\\':
+            output += "\\\\";
+            break;
+        case '\b':
+            output += "\\b";
+            break;
+        case '\f':
+            output += "\\f";
+            break;
+        case '\n':
+            output += "\\n";
+            break;
+        case '\r':
+            output += "\\r";
+            break;
+        case '\t':
+            output += "\\t";
+            break;
+        default:
+            output += "\\u00";
+            output += HEX_DIGITS[c >> 4];
+            output += HEX_DIGITS[c & 0xF];
+        }
+        done = pos + 1;
+    }
+    output.append(text.substr(done));
+}
+
+bool IsNumber(string_view value) {
+    size_t pos = 0;
+    auto skip_digits = [&value, &pos] {
+        size_t begin = pos;
+        while (pos < value.size() && '0' <= value[pos] && value[pos] <= '9') {
+            ++pos;
+        }
+        return pos != begin;
+    };
+
+    if (pos < value.size() && value[pos] == '-') {
+        ++pos;
+    }
+    if (pos < value.size() && value[pos] == '0') {
+        ++pos;
+    }
+    else if (!skip_digits()) {
+        return false;
+    }
+    if (pos < value.size() && value[pos] == '.') {
+        ++pos;
+        if (!skip_digits()) {
+            return false;
+        }
+    }
+    if (pos < value.size() && (value[pos] == 'e' || value[pos] == 'E')) {
+        ++pos;
+        if (pos < value.size() && (value[pos] == '+' || value[pos] == '-')) {
+            ++pos;
+        }
+        if (!skip_digits()) {
+            return false;
+        }
+    }
+    return pos == value.size();
+}
+
 Node LoadNode(istream& input);
 
 Node LoadArray(istream& input) {
@@ -61,8 +259,13 @@ Node LoadInt(istream& input) {
 
 Node LoadString(istream& input) {
     string line;
-    getline(input, line, '"');
-    return Node(move(line));
+    for (char c; input.get(c) && c != '"'; ) {
+        line += c;
+        if (c == '\\' && input.get(c)) {
+            line += c;
+        }
+    }
+    return Node(DecodeString(line));
 }
 
 Node LoadDict(istream& input) {
@@ -102,4 +305,124 @@ Node LoadNode(istream& input) {
 
 Document Load(istream& input) {
     return Document{ LoadNode(input) };
-}
\ No newline at end of file
+}
+
+namespace {
+    // Builds nodes walking structural positions found by Json::StructuralScanner
+    class IndexedLoader {
+    public:
+        IndexedLoader(string_view input, const vector<uint32_t>& positions)
+            : input(input), positions(positions) {
+        }
+
+        Node LoadRoot() {
+            Node root = LoadNode();
+            if (idx != positions.size()) {
+                throw ParseError("unexpected data after root value");
+            }
+            return root;
+        }
+
+    private:
+        char Peek() const {
+            if (idx >= positions.size()) {
+                throw ParseError("unexpected end of input");
+            }
+            return input[positions[idx]];
+        }
+
+        void Expect(char c) {
+            if (Peek() != c) {
+                throw ParseError(string("expected '") + c + "' at " + to_string(positions[idx]));
+            }
+            ++idx;
+        }
+
+        Node LoadNode() {
+            switch (Peek()) {
+            case '[':
+                return LoadArray();
+            case '{':
+                return LoadDict();
+            case '"':
+                return Node(LoadString());
+            default:
+                return LoadInt();
+            }
+        }
+
+        Node LoadArray() {
+            Expect('[');
+            vector<Node> result;
+            if (Peek() == ']') {
+                ++idx;
+                return Node(move(result));
+            }
+            while (true) {
+                result.push_back(LoadNode());
+                if (Peek() == ']') {
+                    ++idx;
+                    return Node(move(result));
+                }
+                Expect(',');
+            }
+        }
+
+        Node LoadDict() {
+            Expect('{');
+            map<string, Node> result;
+            if (Peek() == '}') {
+                ++idx;
+                return Node(move(result));
+            }
+            while (true) {
+                string key = LoadString();
+                Expect(':');
+                result.insert({ move(key), LoadNode() });
+                if (Peek() == '}') {
+                    ++idx;
+                    return Node(move(result));
+                }
+                Expect(',');
+            }
+        }
+
+        string LoadString() {
+            Expect('"');
+            // closing quote is the next structural
+            size_t begin = positions[idx - 1] + 1;
+            Expect('"');
+            size_t end = positions[idx - 1];
+            return DecodeString(input.substr(begin, end - begin));
+        }
+
+        Node LoadInt() {
+            size_t begin = positions[idx++];
+            size_t end = min(input.find_first_of(" \t\n\r{}[]:,\"", begin), input.size());
+            string_view token = input.substr(begin, end - begin);
+            if (!IsNumber(token)) {
+                throw ParseError("bad value at " + to_string(begin) + ": " + string(token));
+            }
+            int result = 0;
+            auto [ptr, ec] = from_chars(token.data(), token.data() + token.size(), result);
+            if (ec != errc() || ptr != token.data() + token.size()) {
+                throw ParseError("number at " + to_string(begin) + " is not int: " + string(token));
+            }
+            return Node(result);
+        }
+
+        string_view input;
+        const vector<uint32_t>& positions;
+        size_t idx = 0;
+    };
+}
+
+Document Load(string_view input) {
+    if (input.size() > UINT32_MAX) {
+        throw ParseError("input is larger than 4 GiB");
+    }
+    vector<uint32_t> positions;
+    Json::StructuralScanner::FindStructurals(input, positions);
+    return Document{ IndexedLoader(input, positions).LoadRoot() };
+}
+}
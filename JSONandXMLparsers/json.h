@@ -1,12 +1,15 @@
 #pragma once
 
 #include <istream>
+#include <stdexcept>
+#include <string_view>
 #include <vector>
 #include <string>
 #include <unordered_map>
 #include <map>
 using namespace std;
 
+namespace Json {
 class Node {
 public:
 	explicit Node(vector<Node> array);
@@ -22,7 +25,7 @@ public:
 private:
 	vector<Node> as_array;
 	map<string, Node> as_map;
-	int as_int;
+	int as_int = 0;
 	string as_string;
 };
 
@@ -36,4 +39,26 @@ private:
 	Node root;
 };
 
-Document Load(istream& input);
\ No newline at end of file
+class ParseError : public runtime_error {
+public:
+	using runtime_error::runtime_error;
+};
+
+// Reads one value char by char and leaves the rest of input in the stream
+Document Load(istream& input);
+
+// Finds structural characters of whole input first, then builds nodes from them.
+// Throws ParseError for malformed input, for data after root value and for values
+// Node can't hold: true, false, null and numbers that are not int
+Document Load(string_view input);
+
+// Contents of string literal without quotes: copied as is when there are no escapes,
+// otherwise escapes including \uXXXX surrogate pairs are decoded to UTF-8
+string DecodeString(string_view raw);
+
+// Appends text escaped as contents of string literal, non-ASCII UTF-8 is kept as is
+void EscapeString(string_view text, string& output);
+
+// Whole value matches number grammar: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+bool IsNumber(string_view value);
+}
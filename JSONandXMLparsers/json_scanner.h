@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace Json {
+/**
+ * @brief Stage one of loading: positions of structural characters
+ * '{', '}', '[', ']', ':', ',' outside of strings, of unescaped quotes
+ * and of first characters of scalars (numbers, true, false, null).
+ * Input is classified by 64-byte blocks.
+ */
+class StructuralScanner {
+public:
+	/**
+	 * @brief Fills positions, uses AVX2 or SSE2 when compiled with them
+	 */
+	static void FindStructurals(std::string_view input, std::vector<uint32_t> & positions);
+
+	/**
+	 * @brief Same as FindStructurals, classifies characters one by one
+	 */
+	static void FindStructuralsScalar(std::string_view input, std::vector<uint32_t> & positions);
+
+private:
+	struct BlockMasks {
+		uint64_t quote = 0;
+		uint64_t backslash = 0;
+		uint64_t whitespace = 0;
+		uint64_t op = 0;
+	};
+
+	/**
+	 * @brief State carried between blocks
+	 */
+	struct Carry {
+		bool is_escaped = false;
+		bool is_in_string = false;
+		bool is_in_scalar = false;
+	};
+
+	template <typename ClassifyFunc>
+	static void Scan(std::string_view input, std::vector<uint32_t> & positions, ClassifyFunc classify);
+
+	static uint64_t Structurals(BlockMasks const & masks, Carry & carry);
+
+	static BlockMasks ClassifyScalar(char const * block);
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+	static BlockMasks ClassifySimd(char const * block);
+#endif
+};
+
+inline void StructuralScanner::FindStructurals(std::string_view input, std::vector<uint32_t> & positions) {
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+	Scan(input, positions, ClassifySimd);
+#else
+	Scan(input, positions, ClassifyScalar);
+#endif
+}
+
+inline void StructuralScanner::FindStructuralsScalar(std::string_view input, std::vector<uint32_t> & positions) {
+	Scan(input, positions, ClassifyScalar);
+}
+
+template <typename ClassifyFunc>
+void StructuralScanner::Scan(std::string_view input, std::vector<uint32_t> & positions, ClassifyFunc classify) {
+	positions.clear();
+	// structurals are rarely denser than one per 4 bytes
+	positions.reserve(input.size() / 4 + 1);
+
+	Carry carry;
+	char tail[64];
+	for (size_t offset = 0; offset < input.size(); offset += 64) {
+		char const * block = input.data() + offset;
+		if (input.size() - offset < 64) {
+			// last block is padded with spaces
+			std::fill(std::copy(block, input.data() + input.size(), tail), tail + 64, ' ');
+			block = tail;
+		}
+
+		uint64_t structurals = Structurals(classify(block), carry);
+		while (structurals) {
+#if defined(__GNUC__)
+			int bit = __builtin_ctzll(structurals);
+#else
+			int bit = 0;
+			while (!(structurals >> bit & 1u)) {
+				++bit;
+			}
+#endif
+			positions.push_back(static_cast<uint32_t>(offset + bit));
+			structurals &= structurals - 1;
+		}
+	}
+}
+
+inline uint64_t StructuralScanner::Structurals(BlockMasks const & masks, Carry & carry) {
+	// backslashes are rare, so escaped characters are found by walking them
+	uint64_t escaped = carry.is_escaped ? 1u : 0u;
+	carry.is_escaped = false;
+	for (uint64_t backslash = masks.backslash; backslash; backslash &= backslash - 1) {
+#if defined(__GNUC__)
+		int bit = __builtin_ctzll(backslash);
+#else
+		int bit = 0;
+		while (!(backslash >> bit & 1u)) {
+			++bit;
+		}
+#endif
+		if (escaped >> bit & 1u) {
+			continue;
+		}
+		if (bit == 63) {
+			carry.is_escaped = true;
+		} else {
+			escaped |= uint64_t(1) << (bit + 1);
+		}
+	}
+
+	uint64_t quote = masks.quote & ~escaped;
+
+	// prefix xor: bit is set for opening quote and characters inside string
+	uint64_t in_string = quote;
+	in_string ^= in_string << 1;
+	in_string ^= in_string << 2;
+	in_string ^= in_string << 4;
+	in_string ^= in_string << 8;
+	in_string ^= in_string << 16;
+	in_string ^= in_string << 32;
+	if (carry.is_in_string) {
+		in_string = ~in_string;
+	}
+	carry.is_in_string = in_string >> 63;
+
+	uint64_t scalar = ~(masks.op | masks.whitespace | quote | in_string);
+	uint64_t scalar_start = scalar & ~(scalar << 1 | (carry.is_in_scalar ? 1u : 0u));
+	carry.is_in_scalar = scalar >> 63;
+
+	return (masks.op & ~in_string) | quote | scalar_start;
+}
+
+inline StructuralScanner::BlockMasks StructuralScanner::ClassifyScalar(char const * block) {
+	BlockMasks masks;
+	for (int i = 0; i < 64; i++) {
+		uint64_t bit = uint64_t(1) << i;
+		switch (block[i]) {
+			case '"':
+				masks.quote |= bit;
+				break;
+			case '\\':
+				masks.backslash |= bit;
+				break;
+			case ' ':
+			case '\t':
+			case '\n':
+			case '\r':
+				masks.whitespace |= bit;
+				break;
+			case '{':
+			case '}':
+			case '[':
+			case ']':
+			case ':':
+			case ',':
+				masks.op |= bit;
+				break;
+			default:
+				break;
+		}
+	}
+	return masks;
+}
+
+#if defined(__AVX2__)
+inline StructuralScanner::BlockMasks StructuralScanner::ClassifySimd(char const * block) {
+	BlockMasks masks;
+	for (int half = 0; half < 2; half++) {
+		__m256i chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(block + half * 32));
+		auto eq = [&chunk](char c) {
+			return _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(c));
+		};
+		auto to_mask = [half](__m256i v) {
+			return static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(v))) << (half * 32);
+		};
+
+		masks.quote |= to_mask(eq('"'));
+		masks.backslash |= to_mask(eq('\\'));
+		masks.whitespace |= to_mask(_mm256_or_si256(_mm256_or_si256(eq(' '), eq('\t')),
+			_mm256_or_si256(eq('\n'), eq('\r'))));
+		// '[' 0x5B and '{' 0x7B, ']' 0x5D and '}' 0x7D differ only in bit 0x20
+		__m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+		__m256i brackets = _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8(0x7B)),
+			_mm256_cmpeq_epi8(folded, _mm256_set1_epi8(0x7D)));
+		masks.op |= to_mask(_mm256_or_si256(brackets, _mm256_or_si256(eq(':'), eq(','))));
+	}
+	return masks;
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+inline StructuralScanner::BlockMasks StructuralScanner::ClassifySimd(char const * block) {
+	BlockMasks masks;
+	for (int quarter = 0; quarter < 4; quarter++) {
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(block + quarter * 16));
+		auto eq = [&chunk](char c) {
+			return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(c));
+		};
+		auto to_mask = [quarter](__m128i v) {
+			return static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(v))) << (quarter * 16);
+		};
+
+		masks.quote |= to_mask(eq('"'));
+		masks.backslash |= to_mask(eq('\\'));
+		masks.whitespace |= to_mask(_mm_or_si128(_mm_or_si128(eq(' '), eq('\t')),
+			_mm_or_si128(eq('\n'), eq('\r'))));
+		// '[' 0x5B and '{' 0x7B, ']' 0x5D and '}' 0x7D differ only in bit 0x20
+		__m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+		__m128i brackets = _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8(0x7B)),
+			_mm_cmpeq_epi8(folded, _mm_set1_epi8(0x7D)));
+		masks.op |= to_mask(_mm_or_si128(brackets, _mm_or_si128(eq(':'), eq(','))));
+	}
+	return masks;
+}
+#endif
+}
\ No newline at end of file
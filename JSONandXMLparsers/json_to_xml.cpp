@@ -0,0 +1,219 @@
+#include "transcode.h"
+#include "json.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+    // ASCII part of XML Name production, bytes of non-ASCII UTF-8 characters are accepted as is
+    bool IsXmlName(string_view name) {
+        auto is_start = [](unsigned char c) {
+            return isalpha(c) || c == '_' || c == ':' || c >= 0x80;
+        };
+        return !name.empty() && is_start(name[0]) && all_of(name.begin() + 1, name.end(), [&](unsigned char c) {
+            return is_start(c) || isdigit(c) || c == '-' || c == '.';
+        });
+    }
+
+    // Reads tokens in place and writes each object as soon as its members are read
+    class FlatArrayTranscoder {
+    public:
+        FlatArrayTranscoder(string_view input, ostream& output, const TranscodeMapping& mapping)
+            : input(input), output(output), mapping(mapping) {
+        }
+
+        void Run() {
+            CheckMapping();
+            output << '<' << mapping.root_element << ">\n";
+            Expect('[');
+            if (Peek() == ']') {
+                ++pos;
+            }
+            else {
+                while (true) {
+                    WriteItem();
+                    if (Peek() == ']') {
+                        ++pos;
+                        break;
+                    }
+                    Expect(',');
+                }
+            }
+            SkipSpaces();
+            if (pos != input.size()) {
+                throw Json::ParseError("unexpected data after root value");
+            }
+            output << "</" << mapping.root_element << ">\n";
+        }
+
+    private:
+        void SkipSpaces() {
+            while (pos < input.size() && isspace(static_cast<unsigned char>(input[pos]))) {
+                ++pos;
+            }
+        }
+
+        char Peek() {
+            SkipSpaces();
+            if (pos == input.size()) {
+                throw Json::ParseError("unexpected end of input");
+            }
+            return input[pos];
+        }
+
+        void Expect(char c) {
+            if (Peek() != c) {
+                throw Json::ParseError(string("expected '") + c + "' at " + to_string(pos));
+            }
+            ++pos;
+        }
+
+        // Raw contents of string literal, escapes are decoded by caller
+        string_view ReadString() {
+            Expect('"');
+            size_t begin = pos;
+            while (pos < input.size() && input[pos] != '"') {
+                pos += input[pos] == '\\' ? 2 : 1;
+            }
+            if (pos >= input.size()) {
+                throw Json::ParseError("unterminated string at " + to_string(begin - 1));
+            }
+            return input.substr(begin, pos++ - begin);
+        }
+
+        // Number, true, false or null, checked whether the member is written or not
+        string_view ReadLiteral() {
+            size_t begin = pos;
+            while (pos < input.size() && (isalnum(static_cast<unsigned char>(input[pos]))
+                || input[pos] == '-' || input[pos] == '+' || input[pos] == '.')) {
+                ++pos;
+            }
+            string_view literal = input.substr(begin, pos - begin);
+            if (literal != "true" && literal != "false" && literal != "null" && !Json::IsNumber(literal)) {
+                throw Json::ParseError("bad literal at " + to_string(begin) + ": " + string(literal));
+            }
+            return literal;
+        }
+
+        // Names of mapping are written as is, so they are checked once before output
+        void CheckMapping() const {
+            unordered_set<string_view> attributes;
+            for (string_view name : { string_view(mapping.root_element), string_view(mapping.item_element) }) {
+                if (!IsXmlName(name)) {
+                    throw Json::ParseError("bad element name in mapping: " + string(name));
+                }
+            }
+            for (const TranscodeField& field : mapping.fields) {
+                if (!IsXmlName(field.attribute)) {
+                    throw Json::ParseError("bad attribute name in mapping: " + field.attribute);
+                }
+                if (!attributes.insert(field.attribute).second) {
+                    throw Json::ParseError("attribute " + field.attribute + " is mapped twice");
+                }
+            }
+        }
+
+        const TranscodeField* FindField(string_view key) const {
+            for (const TranscodeField& field : mapping.fields) {
+                if (field.key == key) {
+                    return &field;
+                }
+            }
+            return nullptr;
+        }
+
+        void WriteItem() {
+            Expect('{');
+            item_keys.clear();
+            output << "  <" << mapping.item_element;
+            if (Peek() == '}') {
+                ++pos;
+                output << "/>\n";
+                return;
+            }
+            while (true) {
+                WriteMember();
+                if (Peek() == '}') {
+                    ++pos;
+                    output << "/>\n";
+                    return;
+                }
+                Expect(',');
+            }
+        }
+
+        void WriteMember() {
+            string_view raw_key = ReadString();
+            string decoded_key;
+            if (raw_key.find('\\') != string_view::npos) {
+                decoded_key = Json::DecodeString(raw_key);
+                raw_key = decoded_key;
+            }
+            Expect(':');
+            // each key is one attribute, and XML doesn't allow repeated attributes
+            if (!item_keys.emplace(raw_key).second) {
+                throw Json::ParseError("duplicate key " + string(raw_key));
+            }
+
+            bool is_string = Peek() == '"';
+            if (!is_string && (input[pos] == '{' || input[pos] == '[')) {
+                throw Json::ParseError("value of " + string(raw_key) + " is not scalar");
+            }
+            string_view value = is_string ? ReadString() : ReadLiteral();
+
+            const TranscodeField* field = FindField(raw_key);
+            if (field == nullptr && !mapping.fields.empty()) {
+                return;
+            }
+            bool is_number = !is_string && value != "true" && value != "false" && value != "null";
+            if (field != nullptr && (field->type == TranscodeField::Type::NUMBER) != is_number) {
+                throw Json::ParseError("unexpected type of " + string(raw_key) + ": " + string(value));
+            }
+
+            if (field == nullptr && !IsXmlName(raw_key)) {
+                throw Json::ParseError("key " + string(raw_key) + " is not XML attribute name");
+            }
+
+            output << ' ' << (field != nullptr ? string_view(field->attribute) : raw_key) << "=\"";
+            if (is_string && value.find('\\') != string_view::npos) {
+                WriteEscaped(Json::DecodeString(value));
+            }
+            else {
+                WriteEscaped(value);
+            }
+            output << '"';
+        }
+
+        void WriteEscaped(string_view text) {
+            for (char c : text) {
+                switch (c) {
+                case '&':
+                    output << "&amp;";
+                    break;
+                case '<':
+                    output << "&lt;";
+                    break;
+                case '>':
+                    output << "&gt;";
+                    break;
+                case '"':
+                    output << "&quot;";
+                    break;
+                default:
+                    output.put(c);
+                }
+            }
+        }
+
+        string_view input;
+        ostream& output;
+        const TranscodeMapping& mapping;
+        size_t pos = 0;
+        // keys of current item
+        unordered_set<string> item_keys;
+    };
+}
+
+void JsonToXml(string_view json, ostream& output, const TranscodeMapping& mapping) {
+    FlatArrayTranscoder(json, output, mapping).Run();
+}
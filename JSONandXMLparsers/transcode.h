@@ -0,0 +1,42 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+// Attribute of item element and key of item object that correspond to each other
+struct TranscodeField {
+	enum class Type {
+		STRING,
+		NUMBER,
+	};
+
+	string attribute;
+	string key;
+	Type type = Type::STRING;
+};
+
+// Both directions share one shape: root element with item elements that carry attributes
+// on XML side, array of flat objects on JSON side
+struct TranscodeMapping {
+	// name of root element written by JsonToXml, XmlToJson accepts any root
+	string root_element = "root";
+	// XmlToJson skips other children of root
+	string item_element = "item";
+	// when empty, every attribute maps to key of the same name as string
+	vector<TranscodeField> fields;
+};
+
+// Writes JSON text while reading XML events, memory besides input is stack of open elements.
+// Predefined entities of attribute values are decoded, nested elements and text are skipped.
+// Throws Xml::XmlParseError for malformed input and for NUMBER field with non-numeric value
+void XmlToJson(string_view xml, ostream& output, const TranscodeMapping& mapping);
+
+// Writes XML text while reading JSON tokens, memory besides input is keys of one object.
+// Members keep their order, members absent from non-empty fields are skipped.
+// Throws Json::ParseError for literal other than number, true, false or null,
+// when input is not array of flat objects, when field has other type,
+// for duplicate keys, for written key that is not XML name and for bad names in mapping
+void JsonToXml(string_view json, ostream& output, const TranscodeMapping& mapping);
@@ -1,85 +1,329 @@
 #include "xml.h"
 
+#include <algorithm>
+#include <iterator>
 #include <string_view>
 #include <iostream>
 using namespace std;
 
-pair<string_view, string_view> Split(string_view line, char by) {
-    size_t pos = line.find(by);
-    string_view left = line.substr(0, pos);
+namespace Xml {
+XmlReader::XmlReader(string_view input) : input(input) {
+}
+
+size_t XmlReader::Depth() const {
+    return open_elements.size();
+}
+
+bool XmlReader::StartsWith(string_view prefix) const {
+    return input.substr(pos, prefix.size()) == prefix;
+}
 
-    if (pos < line.size() && pos + 1 < line.size()) {
-        return { left, line.substr(pos + 1) };
+void XmlReader::SkipSpaces() {
+    while (pos < input.size() && isspace(static_cast<unsigned char>(input[pos]))) {
+        ++pos;
     }
-    else {
-        return { left, string_view() };
+}
+
+void XmlReader::SkipPast(string_view terminator) {
+    size_t end = input.find(terminator, pos);
+    if (end == string_view::npos) {
+        throw XmlParseError("expected " + string(terminator) + " after position " + to_string(pos));
     }
+    pos = end + terminator.size();
 }
 
-string_view Lstrip(string_view line) {
-    while (!line.empty() && isspace(line[0])) {
-        line.remove_prefix(1);
+string_view XmlReader::ReadName() {
+    size_t begin = pos;
+    while (pos < input.size()) {
+        char c = input[pos];
+        if (isspace(static_cast<unsigned char>(c)) || c == '=' || c == '>' || c == '/' || c == '<') {
+            break;
+        }
+        ++pos;
+    }
+    if (begin == pos) {
+        throw XmlParseError("expected name at position " + to_string(pos));
     }
-    return line;
+    return input.substr(begin, pos - begin);
 }
 
-string_view Unquote(string_view value) {
-    if (!value.empty() && value.front() == '"') {
-        value.remove_prefix(1);
+XmlEvent XmlReader::ReadAttribute() {
+    XmlEvent event;
+    event.type = XmlEvent::Type::ATTRIBUTE;
+    event.name = ReadName();
+    SkipSpaces();
+    if (pos == input.size() || input[pos] != '=') {
+        throw XmlParseError("expected = after attribute " + string(event.name));
+    }
+    ++pos;
+    SkipSpaces();
+    if (pos == input.size() || (input[pos] != '"' && input[pos] != '\'')) {
+        throw XmlParseError("expected quoted value of attribute " + string(event.name));
+    }
+    char quote = input[pos++];
+    size_t end = input.find(quote, pos);
+    if (end == string_view::npos) {
+        throw XmlParseError("unterminated value of attribute " + string(event.name));
+    }
+    event.value = input.substr(pos, end - pos);
+    pos = end + 1;
+    return event;
+}
+
+XmlEvent XmlReader::ReadTag() {
+    XmlEvent event;
+    if (StartsWith("</")) {
+        pos += 2;
+        event.type = XmlEvent::Type::END_ELEMENT;
+        event.name = ReadName();
+        SkipSpaces();
+        if (pos == input.size() || input[pos] != '>') {
+            throw XmlParseError("expected > after </" + string(event.name));
+        }
+        ++pos;
+        if (open_elements.empty() || open_elements.back() != event.name) {
+            throw XmlParseError("unexpected </" + string(event.name) + ">");
+        }
+        open_elements.pop_back();
+        return event;
+    }
+
+    ++pos;
+    event.type = XmlEvent::Type::START_ELEMENT;
+    event.name = ReadName();
+    open_elements.push_back(event.name);
+    is_in_tag = true;
+    return event;
+}
+
+XmlEvent XmlReader::NextEvent() {
+    if (is_in_tag) {
+        SkipSpaces();
+        if (StartsWith("/>")) {
+            pos += 2;
+            is_in_tag = false;
+            XmlEvent event;
+            event.type = XmlEvent::Type::END_ELEMENT;
+            event.name = open_elements.back();
+            open_elements.pop_back();
+            return event;
+        }
+        if (pos < input.size() && input[pos] == '>') {
+            ++pos;
+            is_in_tag = false;
+        }
+        else {
+            return ReadAttribute();
+        }
+    }
+
+    while (pos < input.size()) {
+        if (input[pos] != '<') {
+            size_t end = min(input.find('<', pos), input.size());
+            string_view text = input.substr(pos, end - pos);
+            pos = end;
+            while (!text.empty() && isspace(static_cast<unsigned char>(text.front()))) {
+                text.remove_prefix(1);
+            }
+            while (!text.empty() && isspace(static_cast<unsigned char>(text.back()))) {
+                text.remove_suffix(1);
+            }
+            if (!text.empty()) {
+                return { XmlEvent::Type::TEXT, {}, text };
+            }
+        }
+        else if (StartsWith("<!--")) {
+            SkipPast("-->");
+        }
+        else if (StartsWith("<![CDATA[")) {
+            size_t begin = pos + 9;
+            SkipPast("]]>");
+            return { XmlEvent::Type::TEXT, {}, input.substr(begin, pos - 3 - begin) };
+        }
+        else if (StartsWith("<?") || StartsWith("<!")) {
+            SkipPast(">");
+        }
+        else {
+            return ReadTag();
+        }
     }
-    if (!value.empty() && value.back() == '"') {
-        value.remove_suffix(1);
+
+    if (!open_elements.empty()) {
+        throw XmlParseError("unexpected end of input inside <" + string(open_elements.back()) + ">");
     }
-    return value;
+    return {};
 }
 
-Node LoadNode(istream& input) {
-    string root_name;
-    getline(input, root_name);
+Document Document::FromBuffer(shared_ptr<const string> buffer) {
+    // element is pending from its start to end of its parent,
+    // children of open element are after it and are moved to arena when it ends
+    struct PendingNode {
+        Node node;
+        size_t first_child = 0;
+        size_t first_attr = 0;
+    };
+
+    Document doc;
+    vector<PendingNode> pending;
+    vector<size_t> open_elements;
+    // positions of children and attributes of doc.nodes, pointers are set when arena stops growing
+    vector<size_t> first_child;
+    vector<size_t> first_attr;
+    auto to_arena = [&](PendingNode& pending_node) {
+        doc.nodes.push_back(move(pending_node.node));
+        first_child.push_back(pending_node.first_child);
+        first_attr.push_back(pending_node.first_attr);
+    };
 
-    Node root(root_name.substr(1, root_name.size() - 2), {});
-    for (string line; getline(input, line) && Lstrip(line)[1] != '/'; ) {
-        auto [node_name, attrs] = Split(Lstrip(line), ' ');
-        attrs = Split(attrs, '>').first;
-        unordered_map<string, string> node_attrs;
-        while (!attrs.empty()) {
-            auto [head, tail] = Split(attrs, ' ');
-            auto [name, value] = Split(head, '=');
-            if (!name.empty() && !value.empty()) {
-                node_attrs[string(Unquote(name))] = string(Unquote(value));
+    XmlReader reader(*buffer);
+    for (XmlEvent event = reader.NextEvent(); event.type != XmlEvent::Type::END_DOCUMENT; event = reader.NextEvent()) {
+        switch (event.type) {
+        case XmlEvent::Type::START_ELEMENT:
+            if (open_elements.empty() && !doc.nodes.empty()) {
+                throw XmlParseError("document has more than one root element");
+            }
+            open_elements.push_back(pending.size());
+            pending.push_back({ Node(), 0, doc.attributes.size() });
+            pending.back().node.name = event.name;
+            break;
+        case XmlEvent::Type::ATTRIBUTE:
+            doc.attributes.emplace_back(event.name, event.value);
+            ++pending[open_elements.back()].node.attr_count;
+            break;
+        case XmlEvent::Type::END_ELEMENT: {
+            size_t element = open_elements.back();
+            open_elements.pop_back();
+            pending[element].first_child = doc.nodes.size();
+            pending[element].node.child_count = static_cast<uint32_t>(pending.size() - element - 1);
+            // root has no parent to wait for, so it follows its children
+            size_t pending_end = open_elements.empty() ? element : element + 1;
+            for (size_t i = element + 1; i < pending.size(); ++i) {
+                to_arena(pending[i]);
             }
-            attrs = tail;
+            if (open_elements.empty()) {
+                to_arena(pending[element]);
+            }
+            pending.erase(pending.begin() + pending_end, pending.end());
+            break;
+        }
+        default:
+            break;
         }
+    }
+    if (doc.nodes.empty()) {
+        throw XmlParseError("document has no root element");
+    }
 
-        root.AddChild(Node(string(node_name.substr(1)), move(node_attrs)));
+    for (size_t i = 0; i < doc.nodes.size(); ++i) {
+        Node& node = doc.nodes[i];
+        node.children = node.child_count != 0 ? doc.nodes.data() + first_child[i] : nullptr;
+        node.attrs = node.attr_count != 0 ? doc.attributes.data() + first_attr[i] : nullptr;
     }
-    return root;
+    doc.buffer = move(buffer);
+    return doc;
+}
+
+Document Load(string_view input) {
+    return Document::FromBuffer(make_shared<const string>(input));
 }
 
 Document Load(istream& input) {
-    return Document{ LoadNode(input) };
+    return Document::FromBuffer(make_shared<const string>(istreambuf_iterator<char>(input), istreambuf_iterator<char>()));
 }
 
-Node::Node(
-    string name, unordered_map<string, string> attrs
-) : name(move(name)), attrs(move(attrs)) {
+Node::Node(string name, unordered_map<string, string> attrs) {
+    vector<Attribute> views(attrs.begin(), attrs.end());
+    this->name = name;
+    this->attrs = views.data();
+    attr_count = static_cast<uint32_t>(views.size());
+    Detach();
 }
 
-const vector<Node>& Node::Children() const {
-    return children;
+Node::Node(const Node& other)
+    : name(other.name), attrs(other.attrs), children(other.children),
+    attr_count(other.attr_count), child_count(other.child_count), storage(other.storage) {
+    // views into arena would dangle once its Document is destroyed
+    if (!storage) {
+        Detach();
+    }
 }
 
-Document::Document(Node root) : root(move(root)) {
+Node& Node::operator=(const Node& other) {
+    return *this = Node(other);
+}
+
+void Node::Detach() {
+    if (storage && storage.use_count() == 1) {
+        return;
+    }
+
+    auto owned = make_shared<Storage>();
+    size_t text_size = name.size();
+    for (uint32_t i = 0; i < attr_count; ++i) {
+        text_size += attrs[i].first.size() + attrs[i].second.size();
+    }
+    // views stay valid as text is not reallocated
+    owned->text.reserve(text_size);
+    auto append = [&owned](string_view part) {
+        size_t pos = owned->text.size();
+        owned->text += part;
+        return string_view(owned->text).substr(pos, part.size());
+    };
+
+    string_view owned_name = append(name);
+    owned->attrs.reserve(attr_count);
+    for (uint32_t i = 0; i < attr_count; ++i) {
+        string_view key = append(attrs[i].first);
+        owned->attrs.emplace_back(key, append(attrs[i].second));
+    }
+    owned->children.assign(Children().begin(), Children().end());
+
+    name = owned_name;
+    attrs = owned->attrs.data();
+    children = owned->children.data();
+    storage = move(owned);
+}
+
+const string_view* Node::LookupAttribute(string_view attr_name) const {
+    for (uint32_t i = 0; i < attr_count; ++i) {
+        if (attrs[i].first == attr_name) {
+            return &attrs[i].second;
+        }
+    }
+    return nullptr;
+}
+
+string_view Node::FindAttribute(string_view attr_name) const {
+    if (const string_view* value = LookupAttribute(attr_name)) {
+        return *value;
+    }
+    throw out_of_range("no attribute " + string(attr_name) + " in " + string(name));
+}
+
+bool Node::HasAttribute(string_view attr_name) const {
+    return LookupAttribute(attr_name) != nullptr;
+}
+
+NodeRange Node::Children() const {
+    return NodeRange(children, child_count);
+}
+
+Document::Document(Node root) {
+    nodes.push_back(move(root));
 }
 
 const Node& Document::GetRoot() const {
-    return root;
+    return nodes.back();
 }
 
 void Node::AddChild(Node node) {
-    children.push_back(move(node));
+    Detach();
+    storage->children.push_back(move(node));
+    children = storage->children.data();
+    child_count = static_cast<uint32_t>(storage->children.size());
 }
 
 string_view Node::Name() const {
     return name;
-}
\ No newline at end of file
+}
+}
@@ -1,49 +1,230 @@
 #pragma once
 
+#include <charconv>
 #include <istream>
+#include <memory>
 #include <sstream>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 using namespace std;
 
+namespace Xml {
+class XmlParseError : public runtime_error {
+public:
+	using runtime_error::runtime_error;
+};
+
+// Names, values and text point into the buffer of XmlReader.
+// Entities such as &amp; are left as they are
+struct XmlEvent {
+	enum class Type {
+		START_ELEMENT,
+		ATTRIBUTE,
+		END_ELEMENT,
+		TEXT,
+		END_DOCUMENT,
+	};
+
+	Type type = Type::END_DOCUMENT;
+	// element name for START_ELEMENT and END_ELEMENT, attribute name for ATTRIBUTE
+	string_view name;
+	// attribute value for ATTRIBUTE, trimmed text for TEXT
+	string_view value;
+};
+
+class Document;
+
+// Pull parser over contiguous buffer: attributes of element follow its START_ELEMENT,
+// self-closing elements get END_ELEMENT too. Elements nest arbitrarily and may span lines.
+// Whitespace-only text, comments, declarations and processing instructions are skipped,
+// CDATA comes as TEXT. Memory besides the buffer is the stack of open element names
+class XmlReader {
+public:
+	explicit XmlReader(string_view input);
+
+	XmlEvent NextEvent();
+
+	// Count of open elements
+	size_t Depth() const;
+
+private:
+	XmlEvent ReadAttribute();
+	XmlEvent ReadTag();
+	string_view ReadName();
+	void SkipSpaces();
+	void SkipPast(string_view terminator);
+	bool StartsWith(string_view prefix) const;
+
+	string_view input;
+	size_t pos = 0;
+	bool is_in_tag = false;
+	vector<string_view> open_elements;
+};
+
+class Node;
+
+// Contiguous children of Node
+class NodeRange {
+public:
+	NodeRange(const Node* first, size_t count);
+
+	const Node* begin() const;
+	const Node* end() const;
+	size_t size() const;
+	bool empty() const;
+	const Node& front() const;
+	const Node& back() const;
+	const Node& operator[](size_t i) const;
+
+private:
+	const Node* first;
+	size_t count;
+};
+
+// Loaded nodes live in the arena of their Document: names and attributes point into its buffer,
+// children are contiguous ranges of its node pool. Nodes made by hand keep the same layout
+// in own storage, which copies share until one of them is changed by AddChild.
+// Copies of loaded nodes take own storage with the whole subtree, so they outlive the Document
 class Node {
 public:
 	Node(string name, unordered_map<string, string> attrs);
+	Node(const Node& other);
+	Node(Node&&) noexcept = default;
+	Node& operator=(const Node& other);
+	Node& operator=(Node&&) noexcept = default;
 
-	const vector<Node>& Children() const;
+	NodeRange Children() const;
 	void AddChild(Node node);
 	string_view Name() const;
 
+	// Throws out_of_range for missing attribute and XmlParseError for malformed number
 	template <typename T>
-	T AttributeValue(const string& name) const;
+	T AttributeValue(string_view name) const;
+	bool HasAttribute(string_view name) const;
 
 private:
-	string name;
-	vector<Node> children;
-	unordered_map<string, string> attrs;
+	friend class Document;
+
+	using Attribute = pair<string_view, string_view>;
+
+	struct Storage {
+		string text;
+		vector<Attribute> attrs;
+		vector<Node> children;
+	};
+
+	Node() = default;
+
+	// Gives node own storage not shared with copies
+	void Detach();
+
+	// nullptr for missing attribute
+	const string_view* LookupAttribute(string_view name) const;
+	string_view FindAttribute(string_view name) const;
+
+	string_view name;
+	const Attribute* attrs = nullptr;
+	const Node* children = nullptr;
+	uint32_t attr_count = 0;
+	uint32_t child_count = 0;
+	// null for nodes in arena of Document
+	shared_ptr<Storage> storage;
 };
 
 class Document {
 public:
 	explicit Document(Node root);
+	// nodes of arena point to each other, so document is moved only
+	Document(Document&&) = default;
+	Document& operator=(Document&&) = default;
+
+	// Builds tree from XmlReader events over buffer without copying it, text is not kept
+	static Document FromBuffer(shared_ptr<const string> buffer);
 
 	const Node& GetRoot() const;
 
 private:
-	Node root;
+	Document() = default;
+
+	shared_ptr<const string> buffer;
+	// children of every node are contiguous, root is the last node
+	vector<Node> nodes;
+	vector<Node::Attribute> attributes;
 };
 
+// Copies input into buffer of Document::FromBuffer
 Document Load(istream& input);
+Document Load(string_view input);
+
+// Arithmetic types are read by from_chars, string_view points into value.
+// Throws XmlParseError for malformed number
+template <typename T>
+T ParseAttribute(string_view name, string_view value);
 
 
 
 
+inline NodeRange::NodeRange(const Node* first, size_t count) : first(first), count(count) {
+}
+
+inline const Node* NodeRange::begin() const {
+	return first;
+}
+
+inline const Node* NodeRange::end() const {
+	return first + count;
+}
+
+inline size_t NodeRange::size() const {
+	return count;
+}
+
+inline bool NodeRange::empty() const {
+	return count == 0;
+}
+
+inline const Node& NodeRange::front() const {
+	return first[0];
+}
+
+inline const Node& NodeRange::back() const {
+	return first[count - 1];
+}
+
+inline const Node& NodeRange::operator[](size_t i) const {
+	return first[i];
+}
+
+template <typename T>
+inline T ParseAttribute(string_view name, string_view value) {
+	if constexpr (is_same_v<T, string_view>) {
+		return value;
+	}
+	else if constexpr (is_same_v<T, string>) {
+		return string(value);
+	}
+	else if constexpr (is_arithmetic_v<T> && !is_same_v<T, bool>) {
+		T result{};
+		auto [ptr, ec] = from_chars(value.data(), value.data() + value.size(), result);
+		if (ec != errc() || ptr != value.data() + value.size()) {
+			throw XmlParseError("bad value of attribute " + string(name) + ": " + string(value));
+		}
+		return result;
+	}
+	else {
+		istringstream attr_input{ string(value) };
+		T result;
+		attr_input >> result;
+		return result;
+	}
+}
+
 template <typename T>
-inline T Node::AttributeValue(const string& name) const {
-	istringstream attr_input(attrs.at(name));
-	T result;
-	attr_input >> result;
-	return result;
-}
\ No newline at end of file
+inline T Node::AttributeValue(string_view name) const {
+	return ParseAttribute<T>(name, FindAttribute(name));
+}
+}
@@ -0,0 +1,189 @@
+#include "xml_query.h"
+
+#include <algorithm>
+
+namespace Xml {
+XmlSelector::XmlSelector(string_view path) {
+    auto error = [path](const string& what) {
+        return invalid_argument("bad selector " + string(path) + ": " + what);
+    };
+    size_t pos = 0;
+    auto read_name = [path, &pos] {
+        size_t begin = pos;
+        while (pos < path.size() && (isalnum(static_cast<unsigned char>(path[pos]))
+            || path[pos] == '_' || path[pos] == '-' || path[pos] == '.' || path[pos] == ':')) {
+            ++pos;
+        }
+        return path.substr(begin, pos - begin);
+    };
+
+    while (pos < path.size()) {
+        if (path[pos] != '/') {
+            throw error("expected / at " + to_string(pos));
+        }
+        ++pos;
+        if (pos < path.size() && path[pos] == '@') {
+            ++pos;
+            attribute = string(read_name());
+            if (attribute.empty() || pos != path.size()) {
+                throw error("attribute step must be last");
+            }
+            break;
+        }
+
+        Step step;
+        if (pos < path.size() && path[pos] == '*') {
+            step.name = "*";
+            ++pos;
+        }
+        else {
+            step.name = string(read_name());
+        }
+        if (step.name.empty()) {
+            throw error("expected element name at " + to_string(pos));
+        }
+        while (pos < path.size() && path[pos] == '[') {
+            ++pos;
+            if (pos == path.size() || path[pos] != '@') {
+                throw error("expected @ at " + to_string(pos));
+            }
+            ++pos;
+            Predicate predicate;
+            predicate.attribute = string(read_name());
+            if (predicate.attribute.empty() || pos == path.size() || path[pos] != '=') {
+                throw error("expected = at " + to_string(pos));
+            }
+            ++pos;
+            if (pos == path.size() || (path[pos] != '\'' && path[pos] != '"')) {
+                throw error("expected quoted value at " + to_string(pos));
+            }
+            char quote = path[pos++];
+            size_t end = path.find(quote, pos);
+            if (end == string_view::npos) {
+                throw error("unterminated value");
+            }
+            predicate.value = string(path.substr(pos, end - pos));
+            pos = end + 1;
+            if (pos == path.size() || path[pos] != ']') {
+                throw error("expected ] at " + to_string(pos));
+            }
+            ++pos;
+            step.predicates.push_back(move(predicate));
+        }
+        steps.push_back(move(step));
+    }
+    if (steps.empty()) {
+        throw error("no element steps");
+    }
+}
+
+bool XmlSelector::MatchesName(const Step& step, string_view name) {
+    return step.name == "*" || step.name == name;
+}
+
+bool XmlSelector::MatchesPredicates(const Step& step, const vector<Attribute>& attrs) {
+    return all_of(step.predicates.begin(), step.predicates.end(), [&attrs](const Predicate& predicate) {
+        return any_of(attrs.begin(), attrs.end(), [&predicate](const Attribute& attr) {
+            return attr.first == predicate.attribute && attr.second == predicate.value;
+        });
+    });
+}
+
+bool XmlSelector::MatchesPredicates(const Step& step, const Node& node) {
+    return all_of(step.predicates.begin(), step.predicates.end(), [&node](const Predicate& predicate) {
+        return node.HasAttribute(predicate.attribute)
+            && node.AttributeValue<string_view>(predicate.attribute) == predicate.value;
+    });
+}
+
+void XmlSelector::SelectFrom(const Node& node, size_t step_idx, vector<const Node*>& result) const {
+    const Step& step = steps[step_idx];
+    if (!MatchesName(step, node.Name()) || !MatchesPredicates(step, node)) {
+        return;
+    }
+    if (step_idx + 1 == steps.size()) {
+        result.push_back(&node);
+        return;
+    }
+    for (const Node& child : node.Children()) {
+        SelectFrom(child, step_idx + 1, result);
+    }
+}
+
+vector<const Node*> XmlSelector::Select(const Document& doc) const {
+    vector<const Node*> result;
+    SelectFrom(doc.GetRoot(), 0, result);
+    return result;
+}
+
+void XmlSelector::CheckAttributeStep() const {
+    if (attribute.empty()) {
+        throw invalid_argument("selector has no attribute step");
+    }
+}
+
+vector<string_view> XmlSelector::SelectValues(const Document& doc) const {
+    CheckAttributeStep();
+    vector<string_view> result;
+    for (const Node* node : Select(doc)) {
+        if (node->HasAttribute(attribute)) {
+            result.push_back(node->AttributeValue<string_view>(attribute));
+        }
+    }
+    return result;
+}
+
+vector<string_view> XmlSelector::SelectValues(string_view xml) const {
+    CheckAttributeStep();
+    vector<string_view> result;
+    ForEachMatch(xml, [this, &result](const vector<Attribute>& attrs) {
+        for (const auto& [key, value] : attrs) {
+            if (key == attribute) {
+                result.push_back(value);
+                break;
+            }
+        }
+    });
+    return result;
+}
+
+void XmlSelector::ForEachMatch(string_view xml, const function<void(const vector<Attribute>&)>& callback) const {
+    XmlReader reader(xml);
+    // count of leading open elements matched by steps
+    size_t matched = 0;
+    // depth of element which attributes are collected for predicates, 0 when there is none
+    size_t candidate_depth = 0;
+    vector<Attribute> attrs;
+
+    for (XmlEvent event = reader.NextEvent(); ; event = reader.NextEvent()) {
+        if (event.type == XmlEvent::Type::ATTRIBUTE) {
+            if (candidate_depth != 0) {
+                attrs.emplace_back(event.name, event.value);
+            }
+            continue;
+        }
+        // attributes of candidate are complete
+        if (candidate_depth != 0 && MatchesPredicates(steps[candidate_depth - 1], attrs)) {
+            matched = candidate_depth;
+            if (matched == steps.size()) {
+                callback(attrs);
+            }
+        }
+        candidate_depth = 0;
+
+        if (event.type == XmlEvent::Type::END_DOCUMENT) {
+            break;
+        }
+        if (event.type == XmlEvent::Type::START_ELEMENT) {
+            size_t depth = reader.Depth();
+            if (matched + 1 == depth && depth <= steps.size() && MatchesName(steps[depth - 1], event.name)) {
+                candidate_depth = depth;
+                attrs.clear();
+            }
+        }
+        else if (event.type == XmlEvent::Type::END_ELEMENT) {
+            matched = min(matched, reader.Depth());
+        }
+    }
+}
+}
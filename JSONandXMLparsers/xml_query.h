@@ -0,0 +1,96 @@
+#pragma once
+
+#include "xml.h"
+
+#include <array>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace Xml {
+// Compiled subset of XPath: absolute path of child steps, first step matches root.
+// Step is element name or *, followed by any number of [@attribute='value'] predicates,
+// path may end with /@attribute, e.g. /july/spend[@category='food']/@amount
+class XmlSelector {
+public:
+	using Attribute = pair<string_view, string_view>;
+
+	// Throws invalid_argument for path outside of the subset
+	explicit XmlSelector(string_view path);
+
+	// Elements matched by element steps, in document order
+	vector<const Node*> Select(const Document& doc) const;
+
+	// Values of final attribute step, elements without the attribute are skipped.
+	// Throws invalid_argument when path has no attribute step
+	vector<string_view> SelectValues(const Document& doc) const;
+	// Same over XmlReader events of xml without building tree, values point into xml
+	vector<string_view> SelectValues(string_view xml) const;
+
+	// Calls callback with attributes of every element matched by element steps,
+	// memory besides input is stack of open elements and attributes of current one
+	void ForEachMatch(string_view xml, const function<void(const vector<Attribute>&)>& callback) const;
+
+private:
+	struct Predicate {
+		string attribute;
+		string value;
+	};
+
+	struct Step {
+		string name;
+		vector<Predicate> predicates;
+	};
+
+	static bool MatchesName(const Step& step, string_view name);
+	static bool MatchesPredicates(const Step& step, const vector<Attribute>& attrs);
+	static bool MatchesPredicates(const Step& step, const Node& node);
+	void SelectFrom(const Node& node, size_t step_idx, vector<const Node*>& result) const;
+	void CheckAttributeStep() const;
+
+	vector<Step> steps;
+	// empty when path ends with element step
+	string attribute;
+};
+
+// Typed columns of elements matched by rows, read from event stream by ParseAttribute.
+// Throws out_of_range when matched element has no attribute of some column
+template <typename... Columns>
+vector<tuple<Columns...>> SelectColumns(string_view xml, const XmlSelector& rows,
+		const array<string_view, sizeof...(Columns)>& attributes);
+
+
+
+
+namespace xml_query_detail {
+	inline string_view FindColumn(const vector<XmlSelector::Attribute>& attrs, string_view name) {
+		for (const auto& [key, value] : attrs) {
+			if (key == name) {
+				return value;
+			}
+		}
+		throw out_of_range("no attribute " + string(name) + " in selected element");
+	}
+
+	template <typename... Columns, size_t... Is>
+	tuple<Columns...> ParseRow(const vector<XmlSelector::Attribute>& attrs,
+			const array<string_view, sizeof...(Columns)>& attributes, index_sequence<Is...>) {
+		return tuple<Columns...>(ParseAttribute<Columns>(attributes[Is], FindColumn(attrs, attributes[Is]))...);
+	}
+}
+
+template <typename... Columns>
+vector<tuple<Columns...>> SelectColumns(string_view xml, const XmlSelector& rows,
+		const array<string_view, sizeof...(Columns)>& attributes) {
+	vector<tuple<Columns...>> result;
+	rows.ForEachMatch(xml, [&result, &attributes](const vector<XmlSelector::Attribute>& attrs) {
+		result.push_back(xml_query_detail::ParseRow<Columns...>(attrs, attributes, index_sequence_for<Columns...>{}));
+	});
+	return result;
+}
+}
@@ -0,0 +1,100 @@
+#include "transcode.h"
+#include "json.h"
+#include "xml.h"
+
+namespace {
+    const TranscodeField* FindField(const TranscodeMapping& mapping, string_view attribute) {
+        for (const TranscodeField& field : mapping.fields) {
+            if (field.attribute == attribute) {
+                return &field;
+            }
+        }
+        return nullptr;
+    }
+
+    void WriteJsonString(string_view value, ostream& output) {
+        static const pair<string_view, char> entities[] = {
+            { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' },
+        };
+        string decoded;
+        if (value.find('&') != string_view::npos) {
+            for (size_t pos = 0; pos < value.size(); ++pos) {
+                char c = value[pos];
+                if (c == '&') {
+                    for (const auto& [entity, entity_char] : entities) {
+                        if (value.substr(pos, entity.size()) == entity) {
+                            c = entity_char;
+                            pos += entity.size() - 1;
+                            break;
+                        }
+                    }
+                }
+                decoded += c;
+            }
+            value = decoded;
+        }
+        string escaped = "\"";
+        Json::EscapeString(value, escaped);
+        escaped += '"';
+        output << escaped;
+    }
+}
+
+void XmlToJson(string_view xml, ostream& output, const TranscodeMapping& mapping) {
+    Xml::XmlReader reader(xml);
+    bool is_in_item = false;
+    bool is_first_item = true;
+    bool is_first_member = true;
+
+    output.put('[');
+    for (Xml::XmlEvent event = reader.NextEvent(); event.type != Xml::XmlEvent::Type::END_DOCUMENT; event = reader.NextEvent()) {
+        // root is open at depth 1, items at depth 2
+        if (reader.Depth() > 2) {
+            continue;
+        }
+        switch (event.type) {
+        case Xml::XmlEvent::Type::START_ELEMENT:
+            is_in_item = reader.Depth() == 2 && event.name == mapping.item_element;
+            if (is_in_item) {
+                output << (is_first_item ? "{" : ",{");
+                is_first_item = false;
+                is_first_member = true;
+            }
+            break;
+        case Xml::XmlEvent::Type::ATTRIBUTE: {
+            if (!is_in_item) {
+                break;
+            }
+            const TranscodeField* field = FindField(mapping, event.name);
+            if (field == nullptr && !mapping.fields.empty()) {
+                break;
+            }
+            if (!is_first_member) {
+                output.put(',');
+            }
+            is_first_member = false;
+            WriteJsonString(field != nullptr ? string_view(field->key) : event.name, output);
+            output.put(':');
+            if (field != nullptr && field->type == TranscodeField::Type::NUMBER) {
+                if (!Json::IsNumber(event.value)) {
+                    throw Xml::XmlParseError("bad number in attribute " + string(event.name) + ": " + string(event.value));
+                }
+                output << event.value;
+            }
+            else {
+                WriteJsonString(event.value, output);
+            }
+            break;
+        }
+        case Xml::XmlEvent::Type::END_ELEMENT:
+            if (is_in_item && reader.Depth() == 1) {
+                output.put('}');
+                is_in_item = false;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    output.put(']');
+}
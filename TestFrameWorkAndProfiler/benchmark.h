@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Makes compiler assume value is read, so computation of it is not removed
+template <class T>
+inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static const void* volatile sink;
+    sink = &value;
+#endif
+}
+
+// Makes compiler assume any memory is read and written, so stores before it are kept
+inline void ClobberMemory() {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+struct BenchmarkOptions {
+    // Body runs in growing batches before measurement, last batch estimates time of one call
+    std::chrono::nanoseconds warmup = std::chrono::milliseconds(50);
+    // Iterations of every sample are calibrated to take about this time
+    std::chrono::nanoseconds sample_time = std::chrono::milliseconds(10);
+    // At least one, Benchmark throws std::invalid_argument otherwise
+    size_t samples = 21;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    // Input size of RunSizes, 0 for Run
+    size_t size = 0;
+    uint64_t iterations = 0;
+    // Nanoseconds per call of every sample in ascending order
+    std::vector<double> ns_per_op;
+
+    double Median() const {
+        return Percentile(0.5);
+    }
+
+    // Nearest-rank percentile, p is in (0, 1], ns_per_op must not be empty
+    double Percentile(double p) const {
+        size_t rank = static_cast<size_t>(std::ceil(p * ns_per_op.size()));
+        return ns_per_op[std::clamp<size_t>(rank, 1, ns_per_op.size()) - 1];
+    }
+};
+
+// Measures bodies that take nanoseconds to microseconds, where LOG_DURATION only sees 0 ms:
+//   Benchmark bench;
+//   bench.Run("Has", [&] { DoNotOptimize(set.Has(42)); });
+//   bench.WriteJson(report);
+class Benchmark {
+public:
+    explicit Benchmark(BenchmarkOptions options = {}) : options(options) {
+        if (options.samples == 0) {
+            throw std::invalid_argument("benchmark needs at least one sample");
+        }
+    }
+
+    // Body is called with no arguments, result is also printed to cerr
+    template <class Body>
+    const BenchmarkResult& Run(const std::string& name, Body body, size_t size = 0) {
+        // warmup doubles batch until batch is long enough to time one call,
+        // so short batch keeps growing even after warmup time is spent
+        uint64_t iterations = 1;
+        std::chrono::nanoseconds elapsed{};
+        std::chrono::nanoseconds batch_time = Measure(body, iterations);
+        while ((elapsed += batch_time) < options.warmup || batch_time < options.sample_time / 10) {
+            if (batch_time < options.warmup / 4 || batch_time < options.sample_time / 10) {
+                iterations *= 2;
+            }
+            batch_time = Measure(body, iterations);
+        }
+        double estimate = static_cast<double>(batch_time.count()) / iterations;
+
+        BenchmarkResult result;
+        result.name = name;
+        result.size = size;
+        result.iterations = std::max<uint64_t>(1, static_cast<uint64_t>(options.sample_time.count() / std::max(estimate, 1.0)));
+        for (size_t i = 0; i < options.samples; ++i) {
+            result.ns_per_op.push_back(static_cast<double>(Measure(body, result.iterations).count()) / result.iterations);
+        }
+        std::sort(result.ns_per_op.begin(), result.ns_per_op.end());
+
+        Print(result);
+        results.push_back(std::move(result));
+        return results.back();
+    }
+
+    // Setup is called untimed with every size and returns body measured for that size
+    template <class Setup>
+    void RunSizes(const std::string& name, const std::vector<size_t>& sizes, Setup setup) {
+        for (size_t size : sizes) {
+            auto body = setup(size);
+            Run(name + "/" + std::to_string(size), std::move(body), size);
+        }
+    }
+
+    const std::vector<BenchmarkResult>& Results() const {
+        return results;
+    }
+
+    // One object per result for comparison between runs, times are in nanoseconds
+    void WriteJson(std::ostream& output) const {
+        output << "{\"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const BenchmarkResult& result = results[i];
+            output << (i == 0 ? "\n" : ",\n") << "  {\"name\": \"";
+            for (char c : result.name) {
+                if (c == '"' || c == '\\') {
+                    output << '\\';
+                }
+                output << c;
+            }
+            output << "\", \"size\": " << result.size
+                << ", \"iterations\": " << result.iterations
+                << ", \"samples\": " << result.ns_per_op.size()
+                << ", \"median_ns\": " << Fixed(result.Median())
+                << ", \"p99_ns\": " << Fixed(result.Percentile(0.99))
+                << ", \"min_ns\": " << Fixed(result.ns_per_op.front()) << "}";
+        }
+        output << "\n]}\n";
+    }
+
+private:
+    template <class Body>
+    static std::chrono::nanoseconds Measure(Body& body, uint64_t iterations) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            body();
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    }
+
+    static std::string Fixed(double value) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.3f", value);
+        return text;
+    }
+
+    static void Print(const BenchmarkResult& result) {
+        std::cerr << result.name << ": median " << Fixed(result.Median()) << " ns/op, p99 "
+            << Fixed(result.Percentile(0.99)) << " ns/op, min " << Fixed(result.ns_per_op.front()) << " ns/op ("
+            << result.ns_per_op.size() << " x " << result.iterations << " iterations)" << std::endl;
+    }
+
+    BenchmarkOptions options;
+    std::vector<BenchmarkResult> results;
+};
@@ -0,0 +1,134 @@
+#include "test_runner.h"
+#include "benchmark.h"
+
+#include <cstdio>
+#include <sstream>
+
+using namespace std;
+
+// Short enough for unit tests, samples are still calibrated
+BenchmarkOptions FastOptions() {
+    BenchmarkOptions options;
+    options.warmup = chrono::microseconds(100);
+    options.sample_time = chrono::microseconds(100);
+    options.samples = 3;
+    return options;
+}
+
+string Fixed(double value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.3f", value);
+    return text;
+}
+
+void TestPercentile() {
+    BenchmarkResult result;
+    result.ns_per_op = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    ASSERT_EQUAL(result.Median(), 5.0);
+    ASSERT_EQUAL(result.Percentile(0.1), 1.0);
+    ASSERT_EQUAL(result.Percentile(0.11), 2.0);
+    ASSERT_EQUAL(result.Percentile(0.99), 10.0);
+    ASSERT_EQUAL(result.Percentile(1.0), 10.0);
+    // rank below 1 is the smallest sample
+    ASSERT_EQUAL(result.Percentile(0.01), 1.0);
+
+    result.ns_per_op = { 1, 2, 3 };
+    ASSERT_EQUAL(result.Median(), 2.0);
+    result.ns_per_op = { 7 };
+    ASSERT_EQUAL(result.Median(), 7.0);
+    ASSERT_EQUAL(result.Percentile(0.99), 7.0);
+}
+
+void TestRejectsZeroSamples() {
+    BenchmarkOptions options;
+    options.samples = 0;
+    try {
+        Benchmark bench(options);
+        Assert(false, "Benchmark should throw invalid_argument for zero samples");
+    }
+    catch (invalid_argument&) {
+    }
+}
+
+void TestBenchmarkShortWarmup() {
+    // one call is longer than warmup / 4, but batch must still grow to sample_time / 10
+    BenchmarkOptions options;
+    options.warmup = chrono::microseconds(1);
+    options.sample_time = chrono::milliseconds(2);
+    options.samples = 3;
+    Benchmark bench(options);
+    const BenchmarkResult& result = bench.Run("spin", [] {
+        auto start = chrono::steady_clock::now();
+        while (chrono::steady_clock::now() - start < chrono::microseconds(1)) {
+        }
+    });
+    ASSERT_EQUAL(result.ns_per_op.size(), 3u);
+    // estimate from a batch that stopped growing is off by a preemption, then samples are far too short
+    ASSERT(result.iterations * result.Median() > 1e6);
+}
+
+void TestRunSizes() {
+    Benchmark bench(FastOptions());
+    vector<size_t> setup_sizes;
+    bench.RunSizes("sum", { 1, 64 }, [&setup_sizes](size_t size) {
+        setup_sizes.push_back(size);
+        return [values = vector<int>(size, 1)] {
+            int sum = 0;
+            for (int value : values) {
+                sum += value;
+            }
+            DoNotOptimize(sum);
+        };
+    });
+    ASSERT_EQUAL(setup_sizes, (vector<size_t>{ 1, 64 }));
+
+    const vector<BenchmarkResult>& results = bench.Results();
+    ASSERT_EQUAL(results.size(), 2u);
+    ASSERT_EQUAL(results[0].name, "sum/1");
+    ASSERT_EQUAL(results[0].size, 1u);
+    ASSERT_EQUAL(results[1].name, "sum/64");
+    ASSERT_EQUAL(results[1].size, 64u);
+    for (const BenchmarkResult& result : results) {
+        ASSERT_EQUAL(result.ns_per_op.size(), 3u);
+        ASSERT(is_sorted(result.ns_per_op.begin(), result.ns_per_op.end()));
+        ASSERT(result.iterations > 0u);
+    }
+}
+
+void TestWriteJson() {
+    Benchmark empty(FastOptions());
+    ostringstream empty_output;
+    empty.WriteJson(empty_output);
+    ASSERT_EQUAL(empty_output.str(), "{\"benchmarks\": [\n]}\n");
+
+    Benchmark bench(FastOptions());
+    int calls = 0;
+    bench.Run(R"(quote " and \)", [&calls] { DoNotOptimize(++calls); });
+    bench.Run("second", [&calls] { DoNotOptimize(--calls); }, 5);
+    ostringstream output;
+    bench.WriteJson(output);
+
+    string expected = "{\"benchmarks\": [";
+    const vector<string> names = { R"(quote \" and \\)", "second" };
+    for (size_t i = 0; i < names.size(); ++i) {
+        const BenchmarkResult& result = bench.Results()[i];
+        expected += (i == 0 ? "\n" : ",\n");
+        expected += "  {\"name\": \"" + names[i] + "\", \"size\": " + to_string(result.size)
+            + ", \"iterations\": " + to_string(result.iterations) + ", \"samples\": 3"
+            + ", \"median_ns\": " + Fixed(result.Median()) + ", \"p99_ns\": " + Fixed(result.Percentile(0.99))
+            + ", \"min_ns\": " + Fixed(result.ns_per_op.front()) + "}";
+    }
+    expected += "\n]}\n";
+    ASSERT_EQUAL(output.str(), expected);
+    ASSERT_EQUAL(bench.Results()[1].size, 5u);
+}
+
+int main(int argc, char* argv[]) {
+    TestRunner tr;
+    RUN_TEST(tr, TestPercentile);
+    RUN_TEST(tr, TestRejectsZeroSamples);
+    RUN_TEST(tr, TestBenchmarkShortWarmup);
+    RUN_TEST(tr, TestRunSizes);
+    RUN_TEST(tr, TestWriteJson);
+    return tr.Run(TestOptions::FromArgs(argc, argv));
+}
@@ -1,11 +1,21 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <iostream>
 #include <map>
 #include <set>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 
@@ -81,33 +91,308 @@ inline void Assert(bool b, const std::string& hint) {
     AssertEqual(b, true, hint);
 }
 
+// Glob with * for any sequence and ? for any character
+inline bool MatchesGlob(std::string_view pattern, std::string_view name) {
+    size_t pattern_pos = 0;
+    size_t name_pos = 0;
+    // position after last * and name position it was matched against
+    size_t star_pos = std::string_view::npos;
+    size_t star_name_pos = 0;
+    while (name_pos < name.size()) {
+        if (pattern_pos < pattern.size() && (pattern[pattern_pos] == '?' || pattern[pattern_pos] == name[name_pos])) {
+            ++pattern_pos;
+            ++name_pos;
+        }
+        else if (pattern_pos < pattern.size() && pattern[pattern_pos] == '*') {
+            star_pos = ++pattern_pos;
+            star_name_pos = name_pos;
+        }
+        else if (star_pos != std::string_view::npos) {
+            pattern_pos = star_pos;
+            name_pos = ++star_name_pos;
+        }
+        else {
+            return false;
+        }
+    }
+    while (pattern_pos < pattern.size() && pattern[pattern_pos] == '*') {
+        ++pattern_pos;
+    }
+    return pattern_pos == pattern.size();
+}
+
+struct TestOptions {
+    // Test runs when its name matches any of globs, every test runs when there are none
+    std::vector<std::string> filters;
+    // Worker threads, tests run in parallel have to be independent
+    size_t jobs = 1;
+    // Count of slowest tests printed after the run
+    size_t slowest = 0;
+    // JUnit XML report when path ends with .xml, JSON report otherwise, none when empty
+    std::string report_path;
+
+    // TEST_FILTER with comma separated globs, TEST_JOBS, TEST_SLOWEST and TEST_REPORT
+    static TestOptions FromEnvironment() {
+        TestOptions options;
+        auto get = [](const char* name) {
+            const char* value = std::getenv(name);
+            return std::string(value != nullptr ? value : "");
+        };
+        options.SetFilters(get("TEST_FILTER"));
+        options.SetJobs(get("TEST_JOBS"));
+        options.SetSlowest(get("TEST_SLOWEST"));
+        options.report_path = get("TEST_REPORT");
+        return options;
+    }
+
+    // --filter=globs, --jobs=n, --slowest=n and --report=path over environment, other arguments are skipped
+    static TestOptions FromArgs(int argc, char* argv[]) {
+        TestOptions options = FromEnvironment();
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            auto value_of = [arg](std::string_view flag) {
+                return std::string(arg.substr(flag.size()));
+            };
+            if (arg.rfind("--filter=", 0) == 0) {
+                options.SetFilters(value_of("--filter="));
+            }
+            else if (arg.rfind("--jobs=", 0) == 0) {
+                options.SetJobs(value_of("--jobs="));
+            }
+            else if (arg.rfind("--slowest=", 0) == 0) {
+                options.SetSlowest(value_of("--slowest="));
+            }
+            else if (arg.rfind("--report=", 0) == 0) {
+                options.report_path = value_of("--report=");
+            }
+        }
+        return options;
+    }
+
+private:
+    void SetFilters(const std::string& globs) {
+        filters.clear();
+        std::istringstream input(globs);
+        for (std::string glob; std::getline(input, glob, ','); ) {
+            if (!glob.empty()) {
+                filters.push_back(glob);
+            }
+        }
+    }
+
+    void SetJobs(const std::string& value) {
+        if (!value.empty()) {
+            jobs = std::max(1, std::atoi(value.c_str()));
+        }
+    }
+
+    void SetSlowest(const std::string& value) {
+        if (!value.empty()) {
+            slowest = std::max(0, std::atoi(value.c_str()));
+        }
+    }
+};
+
+// RUN_TEST registers test, Run executes selected tests and returns exit code of the suite
 class TestRunner {
 public:
     template <class TestFunc>
     void RunTest(TestFunc func, const std::string& test_name) {
+        tests.push_back({ test_name, std::function<void()>(std::move(func)) });
+    }
+
+    int Run() {
+        return Run(TestOptions::FromEnvironment());
+    }
+
+    // Returns 0 when every selected test passed and 1 otherwise
+    int Run(const TestOptions& options) {
+        std::vector<const TestCase*> selected;
+        for (const TestCase& test : tests) {
+            bool is_selected = options.filters.empty() || std::any_of(options.filters.begin(), options.filters.end(),
+                [&test](const std::string& filter) { return MatchesGlob(filter, test.name); });
+            if (is_selected) {
+                selected.push_back(&test);
+            }
+        }
+        is_run = true;
+
+        std::vector<TestResult> results(selected.size());
+        std::atomic<size_t> next_test{ 0 };
+        std::mutex output_mutex;
+        auto work = [&] {
+            for (size_t i = next_test++; i < selected.size(); i = next_test++) {
+                results[i] = RunOne(*selected[i]);
+                std::lock_guard<std::mutex> lock(output_mutex);
+                Print(results[i]);
+            }
+        };
+        size_t jobs = std::min(std::max<size_t>(options.jobs, 1), std::max<size_t>(selected.size(), 1));
+        if (jobs == 1) {
+            work();
+        }
+        else {
+            std::vector<std::thread> workers;
+            for (size_t i = 0; i < jobs; ++i) {
+                workers.emplace_back(work);
+            }
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+        }
+
+        size_t fail_count = std::count_if(results.begin(), results.end(),
+            [](const TestResult& result) { return !result.is_ok; });
+        PrintSlowest(results, options.slowest);
+        if (!options.report_path.empty()) {
+            WriteReport(results, options.report_path);
+        }
+        if (fail_count > 0) {
+            std::cerr << fail_count << " unit tests failed" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    ~TestRunner() {
+        if (!is_run && !tests.empty()) {
+            std::cerr << tests.size() << " unit tests were registered but not run, call TestRunner::Run" << std::endl;
+        }
+    }
+
+private:
+    struct TestCase {
+        std::string name;
+        std::function<void()> func;
+    };
+
+    struct TestResult {
+        std::string name;
+        bool is_ok = false;
+        std::string message;
+        std::chrono::steady_clock::duration time{};
+    };
+
+    static TestResult RunOne(const TestCase& test) {
+        TestResult result;
+        result.name = test.name;
+        auto start = std::chrono::steady_clock::now();
         try {
-            func();
-            std::cerr << test_name << " OK" << std::endl;
+            test.func();
+            result.is_ok = true;
         }
         catch (std::exception& e) {
-            ++fail_count;
-            std::cerr << test_name << " fail: " << e.what() << std::endl;
+            result.message = e.what();
         }
         catch (...) {
-            ++fail_count;
-            std::cerr << "Unknown exception caught" << std::endl;
+            result.message = "Unknown exception caught";
         }
+        result.time = std::chrono::steady_clock::now() - start;
+        return result;
     }
 
-    ~TestRunner() {
-        if (fail_count > 0) {
-            std::cerr << fail_count << " unit tests failed. Terminate" << std::endl;
-            exit(1);
+    static double Milliseconds(std::chrono::steady_clock::duration time) {
+        return std::chrono::duration<double, std::milli>(time).count();
+    }
+
+    static std::string Fixed(double value, int precision) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.*f", precision, value);
+        return text;
+    }
+
+    static void Print(const TestResult& result) {
+        if (result.is_ok) {
+            std::cerr << result.name << " OK";
         }
+        else {
+            std::cerr << result.name << " fail: " << result.message;
+        }
+        std::cerr << " (" << Fixed(Milliseconds(result.time), 3) << " ms)" << std::endl;
     }
 
-private:
-    int fail_count = 0;
+    static void PrintSlowest(std::vector<TestResult> results, size_t count) {
+        count = std::min(count, results.size());
+        if (count == 0) {
+            return;
+        }
+        std::partial_sort(results.begin(), results.begin() + count, results.end(),
+            [](const TestResult& lhs, const TestResult& rhs) { return lhs.time > rhs.time; });
+        std::cerr << "Slowest tests:" << std::endl;
+        for (size_t i = 0; i < count; ++i) {
+            std::cerr << "  " << results[i].name << " " << Fixed(Milliseconds(results[i].time), 3) << " ms" << std::endl;
+        }
+    }
+
+    static std::string Escape(std::string_view text, bool is_xml) {
+        std::string escaped;
+        for (char c : text) {
+            if (is_xml && (c == '&' || c == '<' || c == '>' || c == '"')) {
+                escaped += c == '&' ? "&amp;" : c == '<' ? "&lt;" : c == '>' ? "&gt;" : "&quot;";
+            }
+            else if (!is_xml && (c == '"' || c == '\\')) {
+                escaped += '\\';
+                escaped += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                char code[8];
+                std::snprintf(code, sizeof(code), is_xml ? "&#%d;" : "\\u%04x", c);
+                escaped += code;
+            }
+            else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    static void WriteReport(const std::vector<TestResult>& results, const std::string& path) {
+        std::ofstream output(path);
+        if (!output) {
+            std::cerr << "can't write test report " << path << std::endl;
+            return;
+        }
+        size_t fail_count = std::count_if(results.begin(), results.end(),
+            [](const TestResult& result) { return !result.is_ok; });
+        bool is_xml = path.size() >= 4 && path.compare(path.size() - 4, 4, ".xml") == 0;
+        if (is_xml) {
+            std::chrono::steady_clock::duration total{};
+            for (const TestResult& result : results) {
+                total += result.time;
+            }
+            output << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                << "<testsuite name=\"tests\" tests=\"" << results.size() << "\" failures=\"" << fail_count
+                << "\" time=\"" << Fixed(Milliseconds(total) / 1000, 6) << "\">\n";
+            for (const TestResult& result : results) {
+                output << "  <testcase name=\"" << Escape(result.name, true)
+                    << "\" time=\"" << Fixed(Milliseconds(result.time) / 1000, 6) << "\"";
+                if (result.is_ok) {
+                    output << "/>\n";
+                }
+                else {
+                    output << ">\n    <failure message=\"" << Escape(result.message, true) << "\"/>\n  </testcase>\n";
+                }
+            }
+            output << "</testsuite>\n";
+        }
+        else {
+            output << "{\"failures\": " << fail_count << ", \"tests\": [";
+            for (size_t i = 0; i < results.size(); ++i) {
+                const TestResult& result = results[i];
+                output << (i == 0 ? "\n" : ",\n") << "  {\"name\": \"" << Escape(result.name, false)
+                    << "\", \"ok\": " << (result.is_ok ? "true" : "false")
+                    << ", \"time_ms\": " << Fixed(Milliseconds(result.time), 3);
+                if (!result.is_ok) {
+                    output << ", \"message\": \"" << Escape(result.message, false) << "\"";
+                }
+                output << "}";
+            }
+            output << "\n]}\n";
+        }
+    }
+
+    std::vector<TestCase> tests;
+    bool is_run = false;
 };
 
 #define ASSERT_EQUAL(x, y) {            \
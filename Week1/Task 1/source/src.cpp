@@ -1,7 +1,9 @@
 #include "test_runner.h"
+#include "benchmark.h"
 
 #include <forward_list>
 #include <iterator>
+#include <string_view>
 
 using namespace std;
 
@@ -132,11 +134,34 @@ void TestEquivalence() {
     ASSERT_EQUAL(2, bucket.front().value);
 }
 
-int main() {
+void BenchmarkHas(Benchmark& bench) {
+    bench.RunSizes("HashSet::Has", { 16, 1024, 65536 }, [](size_t size) {
+        HashSet<int, IntHasher> hash_set(size / 4);
+        for (size_t i = 0; i < size; ++i) {
+            hash_set.Add(static_cast<int>(i * 2));
+        }
+        // half of lookups miss
+        return [hash_set = move(hash_set), size, value = 0]() mutable {
+            DoNotOptimize(hash_set.Has(value));
+            value = (value + 7) % static_cast<int>(size * 2);
+        };
+    });
+}
+
+int main(int argc, char* argv[]) {
     TestRunner tr;
     RUN_TEST(tr, TestSmoke);
     RUN_TEST(tr, TestEmpty);
     RUN_TEST(tr, TestIdempotency);
     RUN_TEST(tr, TestEquivalence);
+    if (tr.Run() != 0) {
+        return 1;
+    }
+
+    if (argc > 1 && string_view(argv[1]) == "bench") {
+        Benchmark bench;
+        BenchmarkHas(bench);
+        bench.WriteJson(cout);
+    }
     return 0;
 }
\ No newline at end of file
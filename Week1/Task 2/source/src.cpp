@@ -125,5 +125,5 @@ int main() {
     TestRunner tr;
     RUN_TEST(tr, Test1);
     RUN_TEST(tr, TestRootOnly);
-    return 0;
+    return tr.Run();
 }
\ No newline at end of file
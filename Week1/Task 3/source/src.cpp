@@ -188,5 +188,5 @@ int main() {
     RUN_TEST(tr, TestZ);
     RUN_TEST(tr, TestDistribution);
 
-    return 0;
+    return tr.Run();
 }
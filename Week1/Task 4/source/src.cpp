@@ -182,5 +182,5 @@ int main() {
     RUN_TEST(tr, TestPurity);
     RUN_TEST(tr, TestDistribution);
 
-    return 0;
+    return tr.Run();
 }
\ No newline at end of file
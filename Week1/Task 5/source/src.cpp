@@ -186,5 +186,5 @@ int main() {
     RUN_TEST(tr, TestSameUser);
     RUN_TEST(tr, TestReplacement);
     RUN_TEST(tr, MyTest);
-    return 0;
+    return tr.Run();
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "xml.h"
+#include "xml_query.h"
 #include "test_runner.h"
 
 #include <algorithm>
@@ -6,6 +7,7 @@
 #include <sstream>
 #include <vector>
 using namespace std;
+using namespace Xml;
 
 struct Spending {
     string category;
@@ -47,11 +49,9 @@ vector<Spending> LoadFromXml(istream& input) {
     Document doc = Load(input);
 
     const Node& node = doc.GetRoot();
+    result.reserve(node.Children().size());
     for (auto& item : node.Children()) {
-        int amount = item.AttributeValue<int>("amount");
-        string categ = item.AttributeValue<string>("category");
-
-        result.push_back({ categ, amount });
+        result.push_back({ item.AttributeValue<string>("category"), item.AttributeValue<int>("amount") });
     }
 
     return result;
@@ -106,8 +106,177 @@ void TestXmlLibrary() {
     ASSERT_EQUAL(july.Children().size(), 1u);
 }
 
+void TestXmlReaderNested() {
+    const string xml_input = R"(<?xml version="1.0"?>
+<year>
+  <!-- first <month> -->
+  <month name="july">
+    <spend amount="2500"
+           category='food'/>
+    <note>paid <![CDATA[<cash>]]></note>
+  </month>
+  <month name="august"></month>
+</year>)";
+
+    XmlReader reader(xml_input);
+    vector<string> events;
+    for (XmlEvent event = reader.NextEvent(); event.type != XmlEvent::Type::END_DOCUMENT; event = reader.NextEvent()) {
+        switch (event.type) {
+        case XmlEvent::Type::START_ELEMENT:
+            events.push_back("<" + string(event.name));
+            break;
+        case XmlEvent::Type::ATTRIBUTE:
+            events.push_back(string(event.name) + "=" + string(event.value));
+            break;
+        case XmlEvent::Type::END_ELEMENT:
+            events.push_back("/" + string(event.name));
+            break;
+        default:
+            events.push_back(string(event.value));
+        }
+    }
+    const vector<string> expected = {
+        "<year", "<month", "name=july", "<spend", "amount=2500", "category=food", "/spend",
+        "<note", "paid", "<cash>", "/note", "/month", "<month", "name=august", "/month", "/year",
+    };
+    ASSERT_EQUAL(events, expected);
+
+    istringstream input(xml_input);
+    Document doc = Load(input);
+    ASSERT_EQUAL(doc.GetRoot().Children().size(), 2u);
+    const Node& july = doc.GetRoot().Children().front();
+    ASSERT_EQUAL(july.AttributeValue<string>("name"), "july");
+    ASSERT_EQUAL(july.Children().front().AttributeValue<int>("amount"), 2500);
+    ASSERT_EQUAL(july.Children().back().Name(), "note");
+    ASSERT_EQUAL(july.AttributeValue<string_view>("name"), "july");
+    ASSERT_EQUAL(july.Children().front().AttributeValue<double>("amount"), 2500.0);
+    try {
+        july.AttributeValue<int>("name");
+        Assert(false, "AttributeValue<int> should throw XmlParseError for july");
+    }
+    catch (XmlParseError&) {
+    }
+
+    for (const string bad : { "<a><b></a>", "<a>", "<a x=1/>", "" }) {
+        try {
+            Load(string_view(bad));
+            Assert(false, "Load should throw XmlParseError for " + bad);
+        }
+        catch (XmlParseError&) {
+        }
+    }
+}
+
+void TestXmlArena() {
+    string xml_input;
+    const int depth = 2000;
+    for (int i = 0; i < depth; ++i) {
+        xml_input += "<level n=\"" + to_string(i) + "\"><leaf/>";
+    }
+    for (int i = 0; i < depth; ++i) {
+        xml_input += "</level>";
+    }
+    Document doc = Load(string_view(xml_input));
+    const Node* node = &doc.GetRoot();
+    for (int i = 0; i < depth; ++i) {
+        ASSERT_EQUAL(node->AttributeValue<int>("n"), i);
+        ASSERT_EQUAL(node->Children().front().Name(), "leaf");
+        node = &node->Children().back();
+    }
+    ASSERT(node->Children().empty());
+
+    Document moved = move(doc);
+    Node root = moved.GetRoot();
+    root.AddChild(Node("spend", { {"amount", "100"} }));
+    ASSERT_EQUAL(root.Children().size(), 3u);
+    ASSERT_EQUAL(moved.GetRoot().Children().size(), 2u);
+    ASSERT_EQUAL(root.Children()[1].Children().back().AttributeValue<int>("n"), 2);
+
+    Node copy = root;
+    copy.AddChild(Node("spend", {}));
+    ASSERT_EQUAL(root.Children().size(), 3u);
+    ASSERT_EQUAL(copy.Children().size(), 4u);
+    ASSERT_EQUAL(copy.Children()[2].AttributeValue<string>("amount"), "100");
+    ASSERT_EQUAL(copy.AttributeValue<int>("n"), 0);
+
+    try {
+        Load(string_view("<a/><b/>"));
+        Assert(false, "Load should throw XmlParseError for two roots");
+    }
+    catch (XmlParseError&) {
+    }
+}
+
+Node LoadSecondChild(string_view xml) {
+    Document doc = Load(xml);
+    return doc.GetRoot().Children()[1];
+}
+
+void TestXmlNodeOutlivesDocument() {
+    Node spend = LoadSecondChild(R"(<july><spend amount="1"/><spend category="travel" amount="2"><note text="taxi"/></spend></july>)");
+    ASSERT_EQUAL(spend.Name(), "spend");
+    ASSERT_EQUAL(spend.AttributeValue<string_view>("category"), "travel");
+    ASSERT_EQUAL(spend.AttributeValue<int>("amount"), 2);
+    ASSERT_EQUAL(spend.Children().size(), 1u);
+    ASSERT_EQUAL(spend.Children().front().AttributeValue<string>("text"), "taxi");
+
+    Node assigned("other", {});
+    {
+        Document doc = Load(string_view("<a x=\"1\"><b/></a>"));
+        assigned = doc.GetRoot();
+    }
+    ASSERT_EQUAL(assigned.Name(), "a");
+    ASSERT_EQUAL(assigned.AttributeValue<int>("x"), 1);
+    ASSERT_EQUAL(assigned.Children().front().Name(), "b");
+}
+
+void TestXmlSelector() {
+    const string xml_input = R"(<july>
+  <spend category="food" amount="2500"/>
+  <spend amount="1150" category="transport"><spend category="food" amount="1"/></spend>
+  <income category="food" amount="7"/>
+  <spend category="food" amount="5780" shop="corner"/>
+  <spend category="food"/>
+</july>)";
+    const XmlSelector food("/july/spend[@category='food']/@amount");
+    const vector<string_view> expected = { "2500", "5780" };
+    ASSERT_EQUAL(food.SelectValues(xml_input), expected);
+
+    Document doc = Load(string_view(xml_input));
+    ASSERT_EQUAL(food.SelectValues(doc), expected);
+    ASSERT_EQUAL(XmlSelector("/july/*[@category=\"food\"]").Select(doc).size(), 4u);
+    ASSERT_EQUAL(XmlSelector("/july/spend/spend").Select(doc).front()->AttributeValue<int>("amount"), 1);
+    ASSERT(XmlSelector("/august/spend").Select(doc).empty());
+
+    const auto rows = SelectColumns<string, int>(xml_input,
+        XmlSelector("/july/spend[@category='food'][@shop='corner']"), { "category", "amount" });
+    ASSERT_EQUAL(rows.size(), 1u);
+    ASSERT_EQUAL(get<0>(rows[0]), "food");
+    ASSERT_EQUAL(get<1>(rows[0]), 5780);
+    try {
+        SelectColumns<int>(xml_input, XmlSelector("/july/spend"), { "amount" });
+        Assert(false, "SelectColumns should throw out_of_range for spend without amount");
+    }
+    catch (out_of_range&) {
+    }
+
+    for (const string bad : { "", "july", "/july/@amount/spend", "/july[category='x']", "/july[@category='x" }) {
+        try {
+            XmlSelector selector(bad);
+            Assert(false, "XmlSelector should throw invalid_argument for " + bad);
+        }
+        catch (invalid_argument&) {
+        }
+    }
+}
+
 int main() {
     TestRunner tr;
     RUN_TEST(tr, TestXmlLibrary);
+    RUN_TEST(tr, TestXmlReaderNested);
+    RUN_TEST(tr, TestXmlArena);
+    RUN_TEST(tr, TestXmlNodeOutlivesDocument);
+    RUN_TEST(tr, TestXmlSelector);
     RUN_TEST(tr, TestLoadFromXml);
+    return tr.Run();
 }
\ No newline at end of file
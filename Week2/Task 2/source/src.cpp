@@ -1,11 +1,14 @@
 #include "json.h"
+#include "json_scanner.h"
 #include "test_runner.h"
 
 #include <algorithm>
 #include <iostream>
+#include <random>
 #include <sstream>
 #include <vector>
 using namespace std;
+using namespace Json;
 
 struct Spending {
     string category;
@@ -101,8 +104,199 @@ void TestJsonLibrary() {
     ASSERT_EQUAL(array_node.AsArray().size(), 1u);
 }
 
+// Char by char structural positions, backslash escapes next char even outside of strings as in scanner
+vector<uint32_t> NaiveStructurals(string_view input) {
+    vector<uint32_t> positions;
+    bool is_in_string = false;
+    bool is_escaped = false;
+    bool is_in_scalar = false;
+    for (uint32_t i = 0; i < input.size(); i++) {
+        char c = input[i];
+        bool is_quote = c == '"' && !is_escaped;
+        is_escaped = c == '\\' && !is_escaped;
+
+        if (is_in_string) {
+            if (is_quote) {
+                positions.push_back(i);
+                is_in_string = false;
+            }
+            continue;
+        }
+
+        bool is_op = string_view("{}[]:,").find(c) != string_view::npos;
+        bool is_space = string_view(" \t\n\r").find(c) != string_view::npos;
+        if (is_quote) {
+            positions.push_back(i);
+            is_in_string = true;
+        }
+        else if (is_op || (!is_space && !is_in_scalar)) {
+            positions.push_back(i);
+        }
+        is_in_scalar = !is_op && !is_space && !is_quote;
+    }
+    return positions;
+}
+
+void AssertNodesEqual(const Node& lhs, const Node& rhs, const string& path = "root") {
+    AssertEqual(lhs.AsInt(), rhs.AsInt(), path + " int");
+    AssertEqual(lhs.AsString(), rhs.AsString(), path + " string");
+    AssertEqual(lhs.AsArray().size(), rhs.AsArray().size(), path + " size");
+    for (size_t i = 0; i < lhs.AsArray().size(); i++) {
+        AssertNodesEqual(lhs.AsArray()[i], rhs.AsArray()[i], path + "[" + to_string(i) + "]");
+    }
+    AssertEqual(lhs.AsMap().size(), rhs.AsMap().size(), path + " keys");
+    for (const auto& [key, value] : lhs.AsMap()) {
+        auto it = rhs.AsMap().find(key);
+        Assert(it != rhs.AsMap().end(), path + " has " + key);
+        AssertNodesEqual(value, it->second, path + "." + key);
+    }
+}
+
+void TestStructuralsOfEscapedQuotes() {
+    string_view input = R"({"a\"b": [1, 2], "c\\": "x"})";
+    vector<uint32_t> positions;
+    StructuralScanner::FindStructurals(input, positions);
+
+    string found;
+    for (uint32_t pos : positions) {
+        found += input[pos];
+    }
+    ASSERT_EQUAL(found, R"({"":[1,2],"":""})");
+}
+
+void TestStructuralsMatchNaive() {
+    mt19937 rng(7);
+    const string alphabet = "{}[]:,\"\\ \t\nab1-.\xD0";
+    // lengths cross 64-byte blocks, so carries of strings and escapes between blocks are covered
+    for (int iteration = 0; iteration < 500; iteration++) {
+        string input(rng() % 300, ' ');
+        for (char& c : input) {
+            c = alphabet[rng() % alphabet.size()];
+        }
+
+        vector<uint32_t> simd;
+        vector<uint32_t> scalar;
+        StructuralScanner::FindStructurals(input, simd);
+        StructuralScanner::FindStructuralsScalar(input, scalar);
+        ASSERT_EQUAL(simd, scalar);
+        ASSERT_EQUAL(scalar, NaiveStructurals(input));
+    }
+}
+
+void TestIndexedLoadMatchesStreamLoad() {
+    vector<string> inputs = {
+        R"({"a": [1, 22, 333, "str"], "b": {}, "c": [], "d": {"e": [[1], [2, {"f": "g"}]]}})",
+        "  [ 1 ,2,\n\t3 ]  ",
+        R"("single string")",
+        R"({"esc\"aped": ["a\\b", "\"q\"", "\u0410\ud83d\ude8c", "\/\b\f\n\r\t"]})",
+        "42",
+    };
+    string spendings = "[";
+    for (int i = 0; i < 200; i++) {
+        spendings += (i == 0 ? "" : ", ") + string(R"({"amount": )") + to_string(i * 37)
+            + R"(, "category": "category \")" + to_string(i) + R"(\""})";
+    }
+    inputs.push_back(spendings + "]");
+
+    for (const string& input : inputs) {
+        istringstream stream_input(input);
+        AssertNodesEqual(Load(string_view(input)).GetRoot(), Load(stream_input).GetRoot());
+    }
+}
+
+void TestStreamLoadLeavesRest() {
+    istringstream input(R"([1, 2] {"a": "b"} 3)");
+    ASSERT_EQUAL(Load(input).GetRoot().AsArray().size(), 2u);
+    ASSERT_EQUAL(Load(input).GetRoot().AsMap().at("a").AsString(), "b");
+    ASSERT_EQUAL(Load(input).GetRoot().AsInt(), 3);
+}
+
+void TestIndexedLoadInts() {
+    const Document doc = Load(string_view("[0, -5, 2147483647, -2147483648]"));
+    const vector<Node>& items = doc.GetRoot().AsArray();
+    ASSERT_EQUAL(items.size(), 4u);
+    ASSERT_EQUAL(items[0].AsInt(), 0);
+    ASSERT_EQUAL(items[1].AsInt(), -5);
+    ASSERT_EQUAL(items[2].AsInt(), 2147483647);
+    ASSERT_EQUAL(items[3].AsInt(), -2147483647 - 1);
+}
+
+void TestIndexedLoadRejectsBadInput() {
+    // Node holds ints only, so true, false, null, fractions and ints out of range are rejected too
+    for (string_view input : { "[1, 2", R"({"a": )", R"({"a" 1})", "[1] [2]", "abc", "[tru]", "[1x]", "[-]", "[01]",
+            "[1.5]", "[1e3]", "[2147483648]", "[-2147483649]", "[true]", R"({"a": null})" }) {
+        try {
+            Load(input);
+            Assert(false, "Load should throw ParseError for " + string(input));
+        }
+        catch (ParseError&) {
+        }
+    }
+}
+
+void TestDecodeString() {
+    ASSERT_EQUAL(DecodeString("plain"), "plain");
+    ASSERT_EQUAL(DecodeString(R"(a\"b\\c\/d\b\f\n\r\t)"), "a\"b\\c/d\b\f\n\r\t");
+    ASSERT_EQUAL(DecodeString(R"(\u0041\u00e9\u4E2D)"), "A\xc3\xa9\xe4\xb8\xad");
+    // characters outside of BMP are surrogate pairs, both cases of hex digits are accepted
+    ASSERT_EQUAL(DecodeString(R"(\ud83d\ude8c)"), "\xf0\x9f\x9a\x8c");
+    ASSERT_EQUAL(DecodeString(R"(x\uD800\uDC00y\uDBFF\uDFFF)"), "x\xf0\x90\x80\x80y\xf4\x8f\xbf\xbf");
+    ASSERT_EQUAL(DecodeString(R"(a\u0000b)"), string("a\0b", 3));
+
+    for (string_view bad : { R"(\x)", R"(\u12)", R"(\u12g4)", R"(\ud83d)", R"(\ud83dx)", R"(\ud83d\u0041)",
+            R"(\ude8c)", "end\\" }) {
+        try {
+            DecodeString(bad);
+            Assert(false, "DecodeString should throw ParseError for " + string(bad));
+        }
+        catch (ParseError&) {
+        }
+    }
+}
+
+void TestEscapeString() {
+    auto escape = [](string_view text) {
+        string output;
+        EscapeString(text, output);
+        return output;
+    };
+    ASSERT_EQUAL(escape("plain \xd0\x90\xf0\x9f\x9a\x8c"), "plain \xd0\x90\xf0\x9f\x9a\x8c");
+    ASSERT_EQUAL(escape("a\"b\\c/\b\f\n\r\t"), R"(a\"b\\c/\b\f\n\r\t)");
+    ASSERT_EQUAL(escape(string("\0\x01\x1f\x20\x7f", 5)), R"(\u0000\u0001\u001f )" "\x7f");
+
+    // every control character round trips through DecodeString
+    string controls;
+    for (int c = 0; c < 0x20; c++) {
+        controls += static_cast<char>(c);
+    }
+    ASSERT_EQUAL(DecodeString(escape(controls)), controls);
+
+    // chars to escape at every offset around 16-byte blocks of the SIMD search, after bytes above 0x7F
+    // which are negative as signed chars and must not be taken for control characters
+    for (char special : { '"', '\\', '\0', '\n', '\x1f' }) {
+        for (size_t offset = 0; offset < 48; offset++) {
+            string text(offset, '\xd0');
+            text += special;
+            text += string(offset % 17, 'a');
+            string escaped = escape(text);
+            ASSERT_EQUAL(escaped.substr(0, offset), string(offset, '\xd0'));
+            Assert(escaped[offset] == '\\', "escape at offset " + to_string(offset));
+            ASSERT_EQUAL(DecodeString(escaped), text);
+        }
+    }
+}
+
 int main() {
     TestRunner tr;
     RUN_TEST(tr, TestJsonLibrary);
     RUN_TEST(tr, TestLoadFromJson);
+    RUN_TEST(tr, TestStructuralsOfEscapedQuotes);
+    RUN_TEST(tr, TestStructuralsMatchNaive);
+    RUN_TEST(tr, TestIndexedLoadMatchesStreamLoad);
+    RUN_TEST(tr, TestStreamLoadLeavesRest);
+    RUN_TEST(tr, TestIndexedLoadInts);
+    RUN_TEST(tr, TestIndexedLoadRejectsBadInput);
+    RUN_TEST(tr, TestDecodeString);
+    RUN_TEST(tr, TestEscapeString);
+    return tr.Run();
 }
\ No newline at end of file
@@ -1,5 +1,11 @@
 #include "ini.h"
 
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <fstream>
+#include <iterator>
+
 namespace Ini {
 	Section& Document::AddSection(std::string name) {
 		return sections[name];
@@ -14,29 +20,368 @@ namespace Ini {
 	}
 
 	Document Load(std::istream& input) {
+		const DocumentView view = LoadView(input);
 		Document doc;
-		std::string str;
-		Ini::Section* current_section = nullptr;
-		while (getline(input, str)) {
-			if (str.empty()) {
+		for (const auto& [name, section_view] : view.sections) {
+			Section& section = doc.AddSection(std::string(name));
+			for (const auto& [key, value] : section_view) {
+				section.insert({ std::string(key), std::string(value) });
+			}
+		}
+		return doc;
+	}
+
+	DocumentView DocumentView::FromBuffer(std::shared_ptr<const std::string> buffer) {
+		DocumentView doc;
+		doc.buffer = std::move(buffer);
+		std::string_view input(*doc.buffer);
+		SectionView* current_section = nullptr;
+		while (!input.empty()) {
+			size_t end = std::min(input.find('\n'), input.size());
+			std::string_view line = input.substr(0u, end);
+			input.remove_prefix(std::min(end + 1u, input.size()));
+			if (!line.empty() && line.back() == '\r') {
+				line.remove_suffix(1u);
+			}
+			if (line.empty()) {
 				continue;
 			}
 
-			if (str[0u] == '[') {
-				std::string_view str_v(str);
-				str_v.remove_suffix(1u);
-				str_v.remove_prefix(1u);
-				if (str_v.size() != 0u) {
-					current_section = &doc.AddSection(static_cast<std::string>(str_v));
+			if (line[0u] == '[') {
+				line.remove_prefix(1u);
+				if (!line.empty() && line.back() == ']') {
+					line.remove_suffix(1u);
+				}
+				if (line.size() != 0u) {
+					current_section = &doc.sections[line];
 				}
 			}
 			else {
-				std::string_view str_v(str);
-				size_t pos = str_v.find('=');
-				current_section->insert({ static_cast<std::string>(str_v.substr(0, pos)), static_cast<std::string>(str_v.substr(pos + 1)) });
+				if (current_section == nullptr) {
+					current_section = &doc.sections[std::string_view()];
+				}
+				size_t pos = std::min(line.find('='), line.size());
+				current_section->insert({ line.substr(0u, pos), line.substr(std::min(pos + 1u, line.size())) });
 			}
 		}
-
 		return doc;
 	}
-}
\ No newline at end of file
+
+	const SectionView& DocumentView::GetSection(std::string_view name) const {
+		return sections.at(name);
+	}
+
+	size_t DocumentView::SectionCount() const {
+		return sections.size();
+	}
+
+	const std::string_view* DocumentView::Lookup(std::string_view section, std::string_view key) const {
+		auto section_it = sections.find(section);
+		if (section_it == sections.end()) {
+			return nullptr;
+		}
+		auto it = section_it->second.find(key);
+		return it != section_it->second.end() ? &it->second : nullptr;
+	}
+
+	std::string_view DocumentView::Find(std::string_view section, std::string_view key) const {
+		if (const std::string_view* value = Lookup(section, key)) {
+			return *value;
+		}
+		throw std::out_of_range("no key " + std::string(key) + " in section " + std::string(section));
+	}
+
+	DocumentView LoadView(std::istream& input) {
+		return DocumentView::FromBuffer(std::make_shared<const std::string>(
+			std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()));
+	}
+
+	DocumentView LoadFile(const std::string& path) {
+		std::ifstream input(path, std::ios::binary | std::ios::ate);
+		if (!input) {
+			throw std::runtime_error("can't open " + path);
+		}
+		std::string buffer(static_cast<size_t>(input.tellg()), '\0');
+		input.seekg(0);
+		if (!input.read(buffer.data(), buffer.size())) {
+			throw std::runtime_error("can't read " + path);
+		}
+		return DocumentView::FromBuffer(std::make_shared<const std::string>(std::move(buffer)));
+	}
+
+	namespace {
+		SectionDiff DiffSection(const SectionView& before, const SectionView& after) {
+			SectionDiff diff;
+			for (const auto& [key, value] : before) {
+				auto it = after.find(key);
+				if (it == after.end()) {
+					diff.removed.emplace_back(key);
+				}
+				else if (it->second != value) {
+					diff.changed.emplace_back(key);
+				}
+			}
+			for (const auto& [key, value] : after) {
+				if (before.count(key) == 0u) {
+					diff.added.emplace_back(key);
+				}
+			}
+			for (auto* keys : { &diff.added, &diff.removed, &diff.changed }) {
+				std::sort(keys->begin(), keys->end());
+			}
+			return diff;
+		}
+
+		bool IsEmpty(const SectionDiff& diff) {
+			return diff.added.empty() && diff.removed.empty() && diff.changed.empty();
+		}
+	}
+
+	DocumentDiff Diff(const DocumentView& before, const DocumentView& after) {
+		static const SectionView empty_section;
+		DocumentDiff diff;
+		for (const auto& [name, section] : before.sections) {
+			auto it = after.sections.find(name);
+			if (it == after.sections.end()) {
+				// removed section is a change even when it is empty
+				diff.emplace(name, DiffSection(section, empty_section));
+				continue;
+			}
+			SectionDiff section_diff = DiffSection(section, it->second);
+			if (!IsEmpty(section_diff)) {
+				diff.emplace(name, std::move(section_diff));
+			}
+		}
+		for (const auto& [name, section] : after.sections) {
+			if (before.sections.count(name) == 0u) {
+				// added section is a change even when it is empty
+				diff.emplace(name, DiffSection(empty_section, section));
+			}
+		}
+		return diff;
+	}
+
+	ReloadableDocument::ReloadableDocument(std::string path)
+		: path(std::move(path)), current(std::make_shared<const DocumentView>(LoadFile(this->path))) {
+	}
+
+	ReloadableDocument::ReloadableDocument(DocumentView doc)
+		: current(std::make_shared<const DocumentView>(std::move(doc))) {
+	}
+
+	std::shared_ptr<const DocumentView> ReloadableDocument::Current() const {
+		return std::atomic_load(&current);
+	}
+
+	DocumentDiff ReloadableDocument::Reload() {
+		return Publish(LoadFile(path));
+	}
+
+	DocumentDiff ReloadableDocument::Publish(DocumentView next) {
+		std::lock_guard<std::mutex> lock(publish_mutex);
+		DocumentDiff diff = Diff(*std::atomic_load(&current), next);
+		if (!diff.empty()) {
+			std::atomic_store(&current, std::make_shared<const DocumentView>(std::move(next)));
+		}
+		return diff;
+	}
+
+	namespace {
+		uint64_t HashKey(std::string_view key) {
+			uint64_t hash = 0x9E3779B97F4A7C15ull ^ key.size();
+			size_t pos = 0u;
+			for (; pos + 8u <= key.size(); pos += 8u) {
+				uint64_t word;
+				std::memcpy(&word, key.data() + pos, 8u);
+				hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+				hash ^= hash >> 32;
+			}
+			uint64_t tail = 0u;
+			std::memcpy(&tail, key.data() + pos, key.size() - pos);
+			hash = (hash ^ tail) * 0xC4CEB9FE1A85EC53ull;
+			return hash ^ (hash >> 33);
+		}
+
+		// Slot hash of key for seed of its bucket, key is hashed only once
+		uint64_t Displace(uint64_t hash, uint32_t seed) {
+			hash ^= seed * 0x9E3779B97F4A7C15ull;
+			hash *= 0xFF51AFD7ED558CCDull;
+			return hash ^ (hash >> 33);
+		}
+
+		uint32_t Reduce(uint32_t hash, size_t range) {
+			return static_cast<uint32_t>((hash * static_cast<uint64_t>(range)) >> 32);
+		}
+
+		size_t BucketCount(size_t key_count) {
+			return key_count / 2u + 1u;
+		}
+
+		uint32_t Bucket(uint64_t hash, size_t key_count) {
+			return Reduce(static_cast<uint32_t>(hash >> 32), BucketCount(key_count));
+		}
+
+		uint32_t FindSlot(std::string_view key, const uint32_t* bucket_seeds, size_t key_count) {
+			uint64_t hash = HashKey(key);
+			return Reduce(static_cast<uint32_t>(Displace(hash, bucket_seeds[Bucket(hash, key_count)])), key_count);
+		}
+
+		// Hash and displace: buckets from the largest one search for seed that puts
+		// all their keys into free slots. Appends bucket seeds, returns key index of every slot
+		std::vector<uint32_t> PlaceKeys(const std::vector<std::string_view>& keys, std::vector<uint32_t>& seeds) {
+			const size_t bucket_count = BucketCount(keys.size());
+			std::vector<uint64_t> hashes(keys.size());
+			std::vector<std::vector<uint32_t>> buckets(bucket_count);
+			for (uint32_t i = 0; i < keys.size(); ++i) {
+				hashes[i] = HashKey(keys[i]);
+				buckets[Bucket(hashes[i], keys.size())].push_back(i);
+			}
+			std::vector<uint32_t> bucket_order(bucket_count);
+			std::iota(bucket_order.begin(), bucket_order.end(), 0u);
+			std::stable_sort(bucket_order.begin(), bucket_order.end(), [&buckets](uint32_t lhs, uint32_t rhs) {
+				return buckets[lhs].size() > buckets[rhs].size();
+			});
+
+			const size_t first_seed = seeds.size();
+			seeds.resize(first_seed + bucket_count, 0u);
+			std::vector<uint32_t> slots(keys.size(), UINT32_MAX);
+			std::vector<uint32_t> bucket_slots;
+			for (uint32_t bucket : bucket_order) {
+				if (buckets[bucket].empty()) {
+					break;
+				}
+				for (uint32_t seed = 1u; ; ++seed) {
+					if (seed == 0u) {
+						throw std::logic_error("ini keys should be unique");
+					}
+					bucket_slots.clear();
+					for (uint32_t key : buckets[bucket]) {
+						uint32_t slot = Reduce(static_cast<uint32_t>(Displace(hashes[key], seed)), keys.size());
+						if (slots[slot] != UINT32_MAX || std::count(bucket_slots.begin(), bucket_slots.end(), slot) != 0) {
+							break;
+						}
+						bucket_slots.push_back(slot);
+					}
+					if (bucket_slots.size() == buckets[bucket].size()) {
+						seeds[first_seed + bucket] = seed;
+						for (size_t i = 0; i < bucket_slots.size(); ++i) {
+							slots[bucket_slots[i]] = buckets[bucket][i];
+						}
+						break;
+					}
+				}
+			}
+			return slots;
+		}
+	}
+
+	FrozenDocument Document::Freeze() const {
+		return FrozenDocument(*this);
+	}
+
+	FrozenDocument::FrozenDocument(const Document& doc) {
+		std::vector<const std::pair<const std::string, Section>*> items;
+		std::vector<std::string_view> names;
+		size_t text_size = 0u;
+		size_t entry_count = 0u;
+		for (const auto& item : doc.sections) {
+			items.push_back(&item);
+			names.push_back(item.first);
+			text_size += item.first.size();
+			for (const auto& [key, value] : item.second) {
+				text_size += key.size() + value.size();
+			}
+			entry_count += item.second.size();
+		}
+		if (text_size > UINT32_MAX) {
+			throw std::length_error("ini document is larger than 4 GiB");
+		}
+		text.reserve(text_size);
+		entries.reserve(entry_count);
+		sections.reserve(items.size());
+
+		std::vector<std::string_view> keys;
+		std::vector<const std::string*> values;
+		for (uint32_t item_idx : PlaceKeys(names, section_seeds)) {
+			const auto& [name, section] = *items[item_idx];
+			keys.clear();
+			values.clear();
+			for (const auto& [key, value] : section) {
+				keys.push_back(key);
+				values.push_back(&value);
+			}
+
+			SectionRecord record;
+			record.name_begin = Append(name);
+			record.name_size = static_cast<uint32_t>(name.size());
+			record.first_entry = static_cast<uint32_t>(entries.size());
+			record.entry_count = static_cast<uint32_t>(keys.size());
+			record.first_seed = static_cast<uint32_t>(seeds.size());
+			for (uint32_t key_idx : PlaceKeys(keys, seeds)) {
+				Entry entry;
+				entry.key_begin = Append(keys[key_idx]);
+				entry.key_size = static_cast<uint32_t>(keys[key_idx].size());
+				entry.value_begin = Append(*values[key_idx]);
+				entry.value_size = static_cast<uint32_t>(values[key_idx]->size());
+				entries.push_back(entry);
+			}
+			sections.push_back(record);
+		}
+	}
+
+	uint32_t FrozenDocument::Append(std::string_view part) {
+		uint32_t begin = static_cast<uint32_t>(text.size());
+		text += part;
+		return begin;
+	}
+
+	std::string_view FrozenDocument::Text(uint32_t begin, uint32_t size) const {
+		return std::string_view(text.data() + begin, size);
+	}
+
+	FrozenSection FrozenDocument::GetSection(std::string_view name) const {
+		if (!sections.empty()) {
+			uint32_t slot = FindSlot(name, section_seeds.data(), sections.size());
+			if (Text(sections[slot].name_begin, sections[slot].name_size) == name) {
+				return FrozenSection(*this, slot);
+			}
+		}
+		throw std::out_of_range("no section " + std::string(name));
+	}
+
+	size_t FrozenDocument::SectionCount() const {
+		return sections.size();
+	}
+
+	FrozenSection::FrozenSection(const FrozenDocument& doc, uint32_t index) : doc(&doc), index(index) {
+	}
+
+	uint32_t FrozenSection::FindEntry(std::string_view key) const {
+		const FrozenDocument::SectionRecord& record = doc->sections[index];
+		if (record.entry_count == 0u) {
+			return 0u;
+		}
+		uint32_t slot = FindSlot(key, doc->seeds.data() + record.first_seed, record.entry_count);
+		const FrozenDocument::Entry& entry = doc->entries[record.first_entry + slot];
+		return doc->Text(entry.key_begin, entry.key_size) == key ? slot : record.entry_count;
+	}
+
+	std::string_view FrozenSection::at(std::string_view key) const {
+		uint32_t slot = FindEntry(key);
+		const FrozenDocument::SectionRecord& record = doc->sections[index];
+		if (slot == record.entry_count) {
+			throw std::out_of_range("no key " + std::string(key) + " in section "
+				+ std::string(doc->Text(record.name_begin, record.name_size)));
+		}
+		const FrozenDocument::Entry& entry = doc->entries[record.first_entry + slot];
+		return doc->Text(entry.value_begin, entry.value_size);
+	}
+
+	size_t FrozenSection::count(std::string_view key) const {
+		return FindEntry(key) != doc->sections[index].entry_count ? 1u : 0u;
+	}
+
+	size_t FrozenSection::size() const {
+		return doc->sections[index].entry_count;
+	}
+}
@@ -1,20 +1,214 @@
 #pragma once
+#include <charconv>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace Ini {
 	using Section = std::unordered_map<std::string, std::string>;
 
+	class FrozenDocument;
+
 	class Document {
 	public:
 		Section& AddSection(std::string name);
 		const Section& GetSection(const std::string& name) const;
 		size_t SectionCount() const;
 
+		// Immutable copy for read-mostly lookups
+		FrozenDocument Freeze() const;
+
 	private:
+		friend class FrozenDocument;
+
 		std::unordered_map<std::string, Section> sections;
 	};
 
+	// Keys of section are placed by minimal perfect hash, so lookup hashes key twice
+	// and compares it with one stored key. Valid while its FrozenDocument is not moved
+	class FrozenSection {
+	public:
+		// Throws out_of_range for missing key
+		std::string_view at(std::string_view key) const;
+		size_t count(std::string_view key) const;
+		size_t size() const;
+
+	private:
+		friend class FrozenDocument;
+
+		FrozenSection(const FrozenDocument& doc, uint32_t index);
+
+		// entry count for missing key
+		uint32_t FindEntry(std::string_view key) const;
+
+		const FrozenDocument* doc;
+		uint32_t index;
+	};
+
+	// Names, keys and values share one buffer, entries of every section are contiguous.
+	// Lookups by string_view do not allocate
+	class FrozenDocument {
+	public:
+		explicit FrozenDocument(const Document& doc);
+
+		// Throws out_of_range for missing section
+		FrozenSection GetSection(std::string_view name) const;
+		size_t SectionCount() const;
+
+	private:
+		friend class FrozenSection;
+
+		struct Entry {
+			uint32_t key_begin;
+			uint32_t key_size;
+			uint32_t value_begin;
+			uint32_t value_size;
+		};
+
+		struct SectionRecord {
+			uint32_t name_begin;
+			uint32_t name_size;
+			uint32_t first_entry;
+			uint32_t entry_count;
+			uint32_t first_seed;
+		};
+
+		std::string_view Text(uint32_t begin, uint32_t size) const;
+		uint32_t Append(std::string_view part);
+
+		std::string text;
+		// in slot order of their section
+		std::vector<Entry> entries;
+		// in slot order of section names
+		std::vector<SectionRecord> sections;
+		// seeds of buckets of every section
+		std::vector<uint32_t> seeds;
+		std::vector<uint32_t> section_seeds;
+	};
+
+	// Keys before the first section go to section with empty name,
+	// lines without '=' are keys with empty value
 	Document Load(std::istream& input);
+
+	using SectionView = std::unordered_map<std::string_view, std::string_view>;
+
+	// Keys in sorted order, keys of added or removed section are all added or removed
+	struct SectionDiff {
+		std::vector<std::string> added;
+		std::vector<std::string> removed;
+		std::vector<std::string> changed;
+	};
+
+	// Only sections that have changes, added and removed sections are changes even when empty
+	using DocumentDiff = std::map<std::string, SectionDiff>;
+
+	// Sections, keys and values point into buffer shared by copies of the view
+	class DocumentView {
+	public:
+		// Parses buffer in place by the rules of Load
+		static DocumentView FromBuffer(std::shared_ptr<const std::string> buffer);
+
+		const SectionView& GetSection(std::string_view name) const;
+		size_t SectionCount() const;
+
+		// Arithmetic types are read by from_chars, bool is true, false, 1 or 0.
+		// Throws out_of_range for missing section or key and invalid_argument for malformed value
+		template <typename T>
+		T Get(std::string_view section, std::string_view key) const;
+
+		// Value of missing section or key is default_value, malformed value still throws
+		template <typename T>
+		T GetOr(std::string_view section, std::string_view key, T default_value) const;
+
+	private:
+		friend Document Load(std::istream& input);
+		friend DocumentDiff Diff(const DocumentView& before, const DocumentView& after);
+
+		std::string_view Find(std::string_view section, std::string_view key) const;
+		const std::string_view* Lookup(std::string_view section, std::string_view key) const;
+
+		template <typename T>
+		static T Parse(std::string_view key, std::string_view value);
+
+		std::shared_ptr<const std::string> buffer;
+		std::unordered_map<std::string_view, SectionView> sections;
+	};
+
+	// Reads whole stream or file with one allocation for the buffer
+	DocumentView LoadView(std::istream& input);
+	DocumentView LoadFile(const std::string& path);
+
+	DocumentDiff Diff(const DocumentView& before, const DocumentView& after);
+
+	// Current document is read by any thread without blocking,
+	// new one is published only when it differs from current
+	class ReloadableDocument {
+	public:
+		explicit ReloadableDocument(std::string path);
+		explicit ReloadableDocument(DocumentView doc);
+
+		// Readers keep returned document alive while they use it
+		std::shared_ptr<const DocumentView> Current() const;
+
+		// Reads file of constructor again, returns empty diff when nothing changed
+		DocumentDiff Reload();
+		DocumentDiff Publish(DocumentView next);
+
+	private:
+		std::string path;
+		// accessed by atomic_load and atomic_store only
+		std::shared_ptr<const DocumentView> current;
+		// serializes reloads, readers never take it
+		std::mutex publish_mutex;
+	};
+
+
+
+
+	template <typename T>
+	T DocumentView::Parse(std::string_view key, std::string_view value) {
+		if constexpr (std::is_same_v<T, std::string_view>) {
+			return value;
+		}
+		else if constexpr (std::is_same_v<T, std::string>) {
+			return std::string(value);
+		}
+		else if constexpr (std::is_same_v<T, bool>) {
+			if (value == "true" || value == "1") {
+				return true;
+			}
+			if (value == "false" || value == "0") {
+				return false;
+			}
+			throw std::invalid_argument("bad bool value of " + std::string(key) + ": " + std::string(value));
+		}
+		else {
+			static_assert(std::is_arithmetic_v<T>, "unsupported type of ini value");
+			T result{};
+			auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+			if (ec != std::errc() || ptr != value.data() + value.size()) {
+				throw std::invalid_argument("bad value of " + std::string(key) + ": " + std::string(value));
+			}
+			return result;
+		}
+	}
+
+	template <typename T>
+	T DocumentView::Get(std::string_view section, std::string_view key) const {
+		return Parse<T>(key, Find(section, key));
+	}
+
+	template <typename T>
+	T DocumentView::GetOr(std::string_view section, std::string_view key, T default_value) const {
+		const std::string_view* value = Lookup(section, key);
+		return value != nullptr ? Parse<T>(key, *value) : default_value;
+	}
 }
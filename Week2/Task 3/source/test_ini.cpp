@@ -106,11 +106,152 @@ void TestDuplicateSections() {
     ASSERT_EQUAL(doc.GetSection("one"), expected);
 }
 
+void TestLoadKeysOutsideSection() {
+    istringstream input("timeout=30\r\n\r\n[july]\r\nfood=2500\r\nflag\r\n");
+    const Ini::Document doc = Ini::Load(input);
+
+    ASSERT_EQUAL(doc.SectionCount(), 2u);
+    const Ini::Section expected_global = { {"timeout", "30"} };
+    const Ini::Section expected_july = { {"food", "2500"}, {"flag", ""} };
+    ASSERT_EQUAL(doc.GetSection(""), expected_global);
+    ASSERT_EQUAL(doc.GetSection("july"), expected_july);
+}
+
+void TestDocumentView() {
+    istringstream input(
+        R"([july]
+food=2500
+travel=23400
+rate=0.5
+enabled=true
+
+[august]
+food=
+)"
+    );
+    const Ini::DocumentView doc = Ini::LoadView(input);
+
+    ASSERT_EQUAL(doc.SectionCount(), 2u);
+    ASSERT_EQUAL(doc.GetSection("july").size(), 4u);
+    ASSERT_EQUAL(doc.Get<string_view>("july", "food"), "2500");
+    ASSERT_EQUAL(doc.Get<int>("july", "travel"), 23400);
+    ASSERT_EQUAL(doc.Get<double>("july", "rate"), 0.5);
+    ASSERT(doc.Get<bool>("july", "enabled"));
+    ASSERT_EQUAL(doc.Get<string>("august", "food"), "");
+    ASSERT_EQUAL(doc.GetOr<int>("august", "sport", 7), 7);
+    ASSERT_EQUAL(doc.GetOr<int>("september", "food", 0), 0);
+
+    try {
+        doc.Get<int>("july", "sport");
+        Assert(false, "Get should throw out_of_range for missing key");
+    }
+    catch (out_of_range&) {
+    }
+    try {
+        doc.Get<int>("july", "rate");
+        Assert(false, "Get<int> should throw invalid_argument for 0.5");
+    }
+    catch (invalid_argument&) {
+    }
+
+    const Ini::DocumentView copy = doc;
+    ASSERT_EQUAL(copy.GetSection("july").at("food").data(), doc.GetSection("july").at("food").data());
+}
+
+void TestReloadDiff() {
+    istringstream first_input("[db]\nhost=a\nport=1\n[cache]\nsize=10\n[old]\nx=1\n");
+    Ini::ReloadableDocument config(Ini::LoadView(first_input));
+    const auto first = config.Current();
+
+    istringstream same_input("[old]\nx=1\n[cache]\nsize=10\n[db]\nport=1\nhost=a\n");
+    ASSERT(config.Publish(Ini::LoadView(same_input)).empty());
+    ASSERT_EQUAL(config.Current(), first);
+
+    istringstream next_input("[db]\nhost=b\nuser=u\n[cache]\nsize=10\n[new]\n");
+    const Ini::DocumentDiff diff = config.Publish(Ini::LoadView(next_input));
+    ASSERT_EQUAL(diff.size(), 3u);
+    const vector<string> expected_added = { "user" };
+    const vector<string> expected_removed = { "port" };
+    const vector<string> expected_changed = { "host" };
+    ASSERT_EQUAL(diff.at("db").added, expected_added);
+    ASSERT_EQUAL(diff.at("db").removed, expected_removed);
+    ASSERT_EQUAL(diff.at("db").changed, expected_changed);
+    ASSERT_EQUAL(diff.at("old").removed, vector<string>{ "x" });
+    ASSERT(diff.at("new").added.empty());
+    ASSERT_EQUAL(diff.count("cache"), 0u);
+
+    ASSERT_EQUAL(config.Current()->Get<string>("db", "host"), "b");
+    ASSERT_EQUAL(first->Get<string>("db", "host"), "a");
+}
+
+void TestDiffOfEmptySections() {
+    istringstream before_input("[kept]\n[gone]\n");
+    istringstream after_input("[kept]\n[new]\n");
+    const Ini::DocumentView before = Ini::LoadView(before_input);
+    const Ini::DocumentView after = Ini::LoadView(after_input);
+
+    const Ini::DocumentDiff forward = Ini::Diff(before, after);
+    ASSERT_EQUAL(forward.size(), 2u);
+    ASSERT_EQUAL(forward.count("gone"), 1u);
+    ASSERT_EQUAL(forward.count("new"), 1u);
+    ASSERT_EQUAL(forward.count("kept"), 0u);
+
+    const Ini::DocumentDiff backward = Ini::Diff(after, before);
+    ASSERT_EQUAL(backward.size(), 2u);
+    ASSERT_EQUAL(backward.count("gone"), 1u);
+    ASSERT_EQUAL(backward.count("new"), 1u);
+}
+
+void TestFreeze() {
+    Ini::Document doc;
+    for (int section_idx = 0; section_idx < 50; ++section_idx) {
+        Ini::Section& section = doc.AddSection("section_" + to_string(section_idx));
+        for (int key_idx = 0; key_idx < section_idx * 40; ++key_idx) {
+            section.insert({ "key_" + to_string(key_idx), to_string(section_idx * key_idx) });
+        }
+    }
+    doc.AddSection("");
+
+    const Ini::FrozenDocument frozen = doc.Freeze();
+    ASSERT_EQUAL(frozen.SectionCount(), 51u);
+    ASSERT_EQUAL(frozen.GetSection("").size(), 0u);
+    ASSERT_EQUAL(frozen.GetSection("").count("key_0"), 0u);
+    for (int section_idx = 0; section_idx < 50; ++section_idx) {
+        const string name = "section_" + to_string(section_idx);
+        const Ini::FrozenSection section = frozen.GetSection(name);
+        ASSERT_EQUAL(section.size(), static_cast<size_t>(section_idx * 40));
+        for (int key_idx = 0; key_idx < section_idx * 40; ++key_idx) {
+            const string key = "key_" + to_string(key_idx);
+            AssertEqual(section.at(key), to_string(section_idx * key_idx), name + " " + key);
+        }
+        ASSERT_EQUAL(section.count("key_" + to_string(section_idx * 40)), 0u);
+    }
+
+    try {
+        frozen.GetSection("section_50");
+        Assert(false, "GetSection should throw out_of_range for unknown section");
+    }
+    catch (out_of_range&) {
+    }
+    try {
+        frozen.GetSection("section_1").at("key_40");
+        Assert(false, "at should throw out_of_range for unknown key");
+    }
+    catch (out_of_range&) {
+    }
+    ASSERT_EQUAL(Ini::Document().Freeze().SectionCount(), 0u);
+}
+
 int main() {
     TestRunner tr;
     RUN_TEST(tr, TestLoadIni);
     RUN_TEST(tr, TestDocument);
     RUN_TEST(tr, TestUnknownSection);
     RUN_TEST(tr, TestDuplicateSections);
-    return 0;
+    RUN_TEST(tr, TestLoadKeysOutsideSection);
+    RUN_TEST(tr, TestDocumentView);
+    RUN_TEST(tr, TestReloadDiff);
+    RUN_TEST(tr, TestDiffOfEmptySections);
+    RUN_TEST(tr, TestFreeze);
+    return tr.Run();
 }
\ No newline at end of file
@@ -1,11 +1,13 @@
 #include "xml.h"
 #include "json.h"
+#include "transcode.h"
 
 #include "test_runner.h"
 
 #include <vector>
 #include <string>
 #include <map>
+#include <sstream>
 
 using namespace std;
 
@@ -89,7 +91,7 @@ void TestJsonToXml() {
     const Xml::Node& root = xml_doc.GetRoot();
 
     ASSERT_EQUAL(root.Name(), root_name);
-    const vector<Xml::Node>& children = root.Children();
+    const Xml::NodeRange children = root.Children();
     ASSERT_EQUAL(children.size(), 6u);
 
     const vector<string> expected_category = {
@@ -108,9 +110,115 @@ void TestJsonToXml() {
     }
 }
 
+void TestStreamingTranscode() {
+    TranscodeMapping mapping;
+    mapping.root_element = "july";
+    mapping.item_element = "spend";
+    mapping.fields = {
+        { "category", "category", TranscodeField::Type::STRING },
+        { "amount", "amount", TranscodeField::Type::NUMBER },
+    };
+
+    const string xml_input = R"(<?xml version="1.0"?>
+<july note="ignored">
+  <spend category="travel" amount="23400"><receipt amount="1"/></spend>
+  <income amount="100"/>
+  <spend amount="5000" category="food &amp; drinks" place="cafe"/>
+</july>)";
+    ostringstream json_output;
+    XmlToJson(xml_input, json_output, mapping);
+    ASSERT_EQUAL(json_output.str(),
+        R"([{"category":"travel","amount":23400},{"amount":5000,"category":"food & drinks"}])");
+
+    ostringstream xml_output;
+    JsonToXml(json_output.str(), xml_output, mapping);
+    ASSERT_EQUAL(xml_output.str(),
+        "<july>\n"
+        "  <spend category=\"travel\" amount=\"23400\"/>\n"
+        "  <spend amount=\"5000\" category=\"food &amp; drinks\"/>\n"
+        "</july>\n");
+
+    ostringstream round_trip;
+    XmlToJson(xml_output.str(), round_trip, mapping);
+    ASSERT_EQUAL(round_trip.str(), json_output.str());
+
+    ostringstream unmapped;
+    JsonToXml(R"([{"quote": "say \"hi\"\u0021", "n": 1}, {}])", unmapped, TranscodeMapping{});
+    ASSERT_EQUAL(unmapped.str(), "<root>\n  <item quote=\"say &quot;hi&quot;!\" n=\"1\"/>\n  <item/>\n</root>\n");
+
+    for (const string bad : { R"([{"amount": "5"}])", R"([{"amount": [1]}])", "[{}", R"({"amount": 1})",
+            R"([{"amount": 1x2}])", R"([{"amount": -}])", R"([{"amount": 01}])", R"([{"amount": true}])" }) {
+        try {
+            ostringstream ignored;
+            JsonToXml(bad, ignored, mapping);
+            Assert(false, "JsonToXml should throw ParseError for " + bad);
+        }
+        catch (Json::ParseError&) {
+        }
+    }
+    // literals are checked even when member is not written
+    for (const string bad : { R"([{"n": nul}])", R"([{"n": 1..2}])", R"([{"n": True}])", R"([{"n": 1e}])" }) {
+        for (const TranscodeMapping& bad_mapping : { TranscodeMapping{}, mapping }) {
+            try {
+                ostringstream ignored;
+                JsonToXml(bad, ignored, bad_mapping);
+                Assert(false, "JsonToXml should throw ParseError for " + bad);
+            }
+            catch (Json::ParseError&) {
+            }
+        }
+    }
+    // keys become attribute names, so they have to be XML names and can't repeat
+    for (const string bad : { R"([{"a b": 1}])", R"([{"x=1": 1}])", R"([{"<": 1}])", R"([{"": 1}])",
+            R"([{"1a": 1}])", R"([{"a": 1, "a": 2}])", R"([{"a": 1, "\u0061": 2}])" }) {
+        try {
+            ostringstream ignored;
+            JsonToXml(bad, ignored, TranscodeMapping{});
+            Assert(false, "JsonToXml should throw ParseError for " + bad);
+        }
+        catch (Json::ParseError&) {
+        }
+    }
+    try {
+        ostringstream ignored;
+        JsonToXml(R"([{"amount": 1, "amount": 2}])", ignored, mapping);
+        Assert(false, "JsonToXml should throw ParseError for duplicate mapped key");
+    }
+    catch (Json::ParseError&) {
+    }
+    TranscodeMapping bad_names = mapping;
+    bad_names.fields[0].attribute = "bad name";
+    TranscodeMapping repeated_attribute = mapping;
+    repeated_attribute.fields[1].attribute = repeated_attribute.fields[0].attribute;
+    for (const TranscodeMapping& bad_mapping : { bad_names, repeated_attribute }) {
+        try {
+            ostringstream ignored;
+            JsonToXml("[]", ignored, bad_mapping);
+            Assert(false, "JsonToXml should throw ParseError for bad mapping");
+        }
+        catch (Json::ParseError&) {
+        }
+    }
+    ostringstream names;
+    JsonToXml(R"([{"_a-1.b": 1, "ns:b": 2, "é": 3}])", names, TranscodeMapping{});
+    ASSERT_EQUAL(names.str(), "<root>\n  <item _a-1.b=\"1\" ns:b=\"2\" \xc3\xa9=\"3\"/>\n</root>\n");
+
+    ostringstream literals;
+    JsonToXml(R"([{"a": -0.5e+3, "b": true, "c": null, "d": 0}])", literals, TranscodeMapping{});
+    ASSERT_EQUAL(literals.str(), "<root>\n  <item a=\"-0.5e+3\" b=\"true\" c=\"null\" d=\"0\"/>\n</root>\n");
+    try {
+        ostringstream ignored;
+        XmlToJson(R"(<july><spend amount="12k"/></july>)", ignored, mapping);
+        Assert(false, "XmlToJson should throw for non-numeric amount");
+    }
+    catch (Xml::XmlParseError&) {
+    }
+}
+
 int main() {
     TestRunner tr;
     RUN_TEST(tr, TestXmlToJson);
     RUN_TEST(tr, TestJsonToXml);
-    return 0;
+    RUN_TEST(tr, TestStreamingTranscode);
+    return tr.Run();
 }
\ No newline at end of file
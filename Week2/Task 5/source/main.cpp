@@ -10,7 +10,7 @@
 #include <functional>
 using namespace std;
 
-void TestAll();
+int TestAll();
 
 unique_ptr<StatsAggregator> ReadAggregators(istream& input) {
     const unordered_map<string, std::function<unique_ptr<StatsAggregator>()>> known_builders = {
@@ -36,7 +36,9 @@ unique_ptr<StatsAggregator> ReadAggregators(istream& input) {
 }
 
 int main() {
-    TestAll();
+    if (TestAll() != 0) {
+        return 1;
+    }
 
     auto stats_aggregator = ReadAggregators(cin);
 
@@ -48,7 +50,7 @@ int main() {
     return 0;
 }
 
-void TestAll() {
+int TestAll() {
     TestRunner tr;
     RUN_TEST(tr, StatsAggregators::TestSum);
     RUN_TEST(tr, StatsAggregators::TestMin);
@@ -56,4 +58,5 @@ void TestAll() {
     RUN_TEST(tr, StatsAggregators::TestAverage);
     RUN_TEST(tr, StatsAggregators::TestMode);
     RUN_TEST(tr, StatsAggregators::TestComposite);
+    return tr.Run();
 }
\ No newline at end of file
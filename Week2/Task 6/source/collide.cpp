@@ -161,7 +161,7 @@ void TestAddingNewObjectOnMap() {
 int main() {
     TestRunner tr;
     RUN_TEST(tr, TestAddingNewObjectOnMap);
-    return 0;
+    return tr.Run();
 }
 
 bool Unit::CollideWith(const Unit& that) const {
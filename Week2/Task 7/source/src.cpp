@@ -282,4 +282,5 @@ void TestServer() {
 int main() {
     TestRunner tr;
     RUN_TEST(tr, TestServer<CommentServer>);
+    return tr.Run();
 }
\ No newline at end of file
@@ -59,5 +59,5 @@ int main() {
     TestRunner tr;
     RUN_TEST(tr, UseExample);
     RUN_TEST(tr, TestInitializerIsntCalled);
-    return 0;
+    return tr.Run();
 }
\ No newline at end of file
@@ -125,4 +125,5 @@ int main() {
     TestRunner tr;
     RUN_TEST(tr, TestConcurrentUpdate);
     RUN_TEST(tr, TestProducerConsumer);
+    return tr.Run();
 }
\ No newline at end of file
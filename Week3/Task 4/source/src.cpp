@@ -285,4 +285,5 @@ int main() {
     RUN_TEST(tr, TestStringKeys);
     RUN_TEST(tr, TestUserType);
     RUN_TEST(tr, TestHas);
+    return tr.Run();
 }
\ No newline at end of file
@@ -309,5 +309,5 @@ int main() {
     RUN_TEST(tr, TestEvaluation);
     RUN_TEST(tr, TestConstAccess);
     RUN_TEST(tr, TestNonconstAccess);
-    return 0;
+    return tr.Run();
 }
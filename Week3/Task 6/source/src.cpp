@@ -58,4 +58,5 @@ void TestZoo() {
 int main() {
     TestRunner tr;
     RUN_TEST(tr, TestZoo);
+    return tr.Run();
 }
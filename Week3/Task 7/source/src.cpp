@@ -236,5 +236,5 @@ void TestSanity() {
 int main() {
     TestRunner tr;
     RUN_TEST(tr, TestSanity);
-    return 0;
+    return tr.Run();
 }
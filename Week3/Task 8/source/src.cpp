@@ -82,5 +82,5 @@ void Test() {
 int main() {
     TestRunner tr;
     RUN_TEST(tr, Test);
-    return 0;
+    return tr.Run();
 }
\ No newline at end of file
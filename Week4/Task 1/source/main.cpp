@@ -195,5 +195,5 @@ int main() {
   RUN_TEST(tr, TestSmallTexture);
   RUN_TEST(tr, TestCow);
   RUN_TEST(tr, TestCpp);
-  return 0;
+  return tr.Run();
 }
\ No newline at end of file
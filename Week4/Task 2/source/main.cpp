@@ -212,5 +212,5 @@ int main() {
   RUN_CACHE_TEST(tr, TestAsync);
 
 #undef RUN_CACHE_TEST
-  return 0;
+  return tr.Run();
 }
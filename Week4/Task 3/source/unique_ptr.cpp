@@ -155,4 +155,5 @@ int main() {
   RUN_TEST(tr, TestLifetime);
   RUN_TEST(tr, TestGetters);
   //RUN_TEST(tr, Test);
+  return tr.Run();
 }
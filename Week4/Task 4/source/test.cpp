@@ -68,5 +68,5 @@ int main() {
   RUN_TEST(tr, TestNoOverbooking);
   RUN_TEST(tr, TestFlightOverbooking);
   RUN_TEST(tr, TestHotelOverbooking);
-  return 0;
+  return tr.Run();
 }
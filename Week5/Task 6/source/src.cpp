@@ -279,5 +279,5 @@ int main() {
   RUN_TEST(tr, TestZeros);
   RUN_TEST(tr, TestThree);
   RUN_TEST(tr, TestPrintStats);
-  return 0;
+  return tr.Run();
 }
\ No newline at end of file
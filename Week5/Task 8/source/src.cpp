@@ -75,6 +75,9 @@ void TestSimple() {
 int main() {
   TestRunner tr;
   RUN_TEST(tr, TestSimple);
+  if (tr.Run() != 0) {
+    return 1;
+  }
 
   const vector<Domain> banned_domains = ReadDomains();
   const vector<Domain> domains_to_check = ReadDomains();